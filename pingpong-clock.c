@@ -0,0 +1,83 @@
+// PingPongOS - PingPong Operating System
+
+// Teste do relogio em nanossegundos - uma tarefa periodica acorda a cada
+// 500 us com task_sleep_until enquanto outra dorme intervalos variados com
+// task_sleep_us; ambas medem o atraso de cada despertar.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define PERIOD_US 500
+#define PERIODS   4000
+#define NAPS      200
+
+task_t Periodic, Napper ;
+
+// mede o atraso de cada despertar em relacao ao instante pedido
+void report (unsigned long long wanted, unsigned long long *late,
+             unsigned long long *worst, int *early)
+{
+   unsigned long long now = systime_ns () ;
+
+   if (now < wanted)
+      (*early)++ ;
+   else
+   {
+      *late += now - wanted ;
+      if (now - wanted > *worst)
+         *worst = now - wanted ;
+   }
+}
+
+// acorda em instantes absolutos, sem acumular o atraso de cada periodo
+void PeriodicBody (void * arg)
+{
+   unsigned long long next, late = 0, worst = 0 ;
+   int i, early = 0 ;
+
+   next = systime_ns () ;
+   for (i=0; i<PERIODS; i++)
+   {
+      next += PERIOD_US * 1000ULL ;
+      task_sleep_until (next) ;
+      report (next, &late, &worst, &early) ;
+   }
+   printf ("%s: %d periodos de %d us, atraso medio %llu us, maximo %llu us, %d adiantados\n",
+           (char *) arg, PERIODS, PERIOD_US, late / PERIODS / 1000, worst / 1000, early) ;
+   task_exit (0) ;
+}
+
+// dorme de 100 us a 5 ms
+void NapperBody (void * arg)
+{
+   unsigned long long naps[] = {100, 250, 1500, 5000}, wanted, late = 0, worst = 0 ;
+   int i, early = 0 ;
+
+   for (i=0; i<NAPS; i++)
+   {
+      wanted = systime_ns () + naps[i % 4] * 1000ULL ;
+      task_sleep_us (naps[i % 4]) ;
+      report (wanted, &late, &worst, &early) ;
+   }
+   printf ("%s: %d cochilos, atraso medio %llu us, maximo %llu us, %d adiantados\n",
+           (char *) arg, NAPS, late / NAPS / 1000, worst / 1000, early) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   task_create (&Periodic, PeriodicBody, "Periodic") ;
+   task_create (&Napper, NapperBody, "Napper") ;
+
+   task_join (&Periodic) ;
+   task_join (&Napper) ;
+
+   printf ("main: fim\n");
+   task_exit (0) ;
+   exit (0) ;
+}
@@ -0,0 +1,177 @@
+// PingPongOS - PingPong Operating System
+
+// Teste das variaveis de condicao - um buffer limitado eh usado por
+// produtores e consumidores, primeiro com os semaforos sItem/sVaga/sBuffer do
+// pingpong-prodcons, depois com um mutex e duas condicoes; as somas devem
+// bater e os tempos sao comparados. Por fim um cond_broadcast libera varias
+// tarefas esperando a mesma condicao.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUM_PROD   2
+#define NUM_CONS   2
+#define NUM_ITEMS  50000
+#define BUFSIZE    5
+#define NUM_WAIT   5
+
+task_t Prod[NUM_PROD], Cons[NUM_CONS], Waiter[NUM_WAIT] ;
+int buffer[BUFSIZE], first, count ;
+long produced, consumed ;
+int failures = 0 ;
+
+semaphore_t sItem, sVaga, sBuffer ;
+mutex_t m ;
+cond_t notEmpty, notFull, go ;
+int started, woken ;
+
+// buffer com semaforos, como no pingpong-prodcons
+void SemProdBody (void * arg)
+{
+   int i ;
+
+   for (i=1; i<=NUM_ITEMS; i++)
+   {
+      sem_down (&sVaga) ;
+      sem_down (&sBuffer) ;
+      buffer[(first + count) % BUFSIZE] = i ;
+      count++ ;
+      produced += i ;
+      sem_up (&sBuffer) ;
+      sem_up (&sItem) ;
+   }
+   task_exit (0) ;
+}
+
+void SemConsBody (void * arg)
+{
+   int i ;
+
+   for (i=0; i<NUM_ITEMS * NUM_PROD / NUM_CONS; i++)
+   {
+      sem_down (&sItem) ;
+      sem_down (&sBuffer) ;
+      consumed += buffer[first] ;
+      first = (first + 1) % BUFSIZE ;
+      count-- ;
+      sem_up (&sBuffer) ;
+      sem_up (&sVaga) ;
+   }
+   task_exit (0) ;
+}
+
+// buffer com um mutex e duas condicoes
+void CondProdBody (void * arg)
+{
+   int i ;
+
+   for (i=1; i<=NUM_ITEMS; i++)
+   {
+      mutex_lock (&m) ;
+      while (count == BUFSIZE)
+         cond_wait (&notFull, &m) ;
+      buffer[(first + count) % BUFSIZE] = i ;
+      count++ ;
+      produced += i ;
+      cond_signal (&notEmpty) ;
+      mutex_unlock (&m) ;
+   }
+   task_exit (0) ;
+}
+
+void CondConsBody (void * arg)
+{
+   int i ;
+
+   for (i=0; i<NUM_ITEMS * NUM_PROD / NUM_CONS; i++)
+   {
+      mutex_lock (&m) ;
+      while (count == 0)
+         cond_wait (&notEmpty, &m) ;
+      consumed += buffer[first] ;
+      first = (first + 1) % BUFSIZE ;
+      count-- ;
+      cond_signal (&notFull) ;
+      mutex_unlock (&m) ;
+   }
+   task_exit (0) ;
+}
+
+// espera a largada
+void WaiterBody (void * arg)
+{
+   mutex_lock (&m) ;
+   while (!started)
+      cond_wait (&go, &m) ;
+   woken++ ;
+   mutex_unlock (&m) ;
+   task_exit (0) ;
+}
+
+void run (char *name, void (*prod)(void *), void (*cons)(void *))
+{
+   unsigned long long t ;
+   int i ;
+
+   first = count = 0 ;
+   produced = consumed = 0 ;
+
+   t = systime_ns () ;
+   for (i=0; i<NUM_PROD; i++)
+      task_create (&Prod[i], prod, NULL) ;
+   for (i=0; i<NUM_CONS; i++)
+      task_create (&Cons[i], cons, NULL) ;
+   for (i=0; i<NUM_PROD; i++)
+      task_join (&Prod[i]) ;
+   for (i=0; i<NUM_CONS; i++)
+      task_join (&Cons[i]) ;
+   t = systime_ns () - t ;
+
+   printf ("%s: %d itens em %llu ms\n", name, NUM_ITEMS * NUM_PROD, t / 1000000) ;
+
+   if (produced != consumed || count != 0)
+   {
+      printf ("%s: FALHOU, produziu %ld e consumiu %ld\n", name, produced, consumed) ;
+      failures++ ;
+   }
+}
+
+int main (int argc, char *argv[])
+{
+   int i ;
+
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   sem_create (&sItem, 0) ;
+   sem_create (&sVaga, BUFSIZE) ;
+   sem_create (&sBuffer, 1) ;
+   mutex_create (&m) ;
+   cond_create (&notEmpty) ;
+   cond_create (&notFull) ;
+   cond_create (&go) ;
+
+   run ("semaforos", SemProdBody, SemConsBody) ;
+   run ("condicoes", CondProdBody, CondConsBody) ;
+
+   // todas as tarefas esperando saem com um so broadcast
+   for (i=0; i<NUM_WAIT; i++)
+      task_create (&Waiter[i], WaiterBody, NULL) ;
+   task_yield () ;
+   mutex_lock (&m) ;
+   started = 1 ;
+   cond_broadcast (&go) ;
+   mutex_unlock (&m) ;
+   for (i=0; i<NUM_WAIT; i++)
+      task_join (&Waiter[i]) ;
+
+   printf ("broadcast: %d de %d tarefas acordadas\n", woken, NUM_WAIT) ;
+   if (woken != NUM_WAIT)
+      failures++ ;
+
+   printf ("main: fim, %d falhas\n", failures);
+   task_exit (0) ;
+   exit (0) ;
+}
@@ -0,0 +1,101 @@
+// PingPongOS - PingPong Operating System
+
+// Teste da classe de tempo real (EDF) - tarefas periodicas competindo com
+// tarefas normais que so usam processador
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define JOBS     20
+#define WORKLOAD 20000
+
+// descricao de uma tarefa periodica
+typedef struct
+{
+   char *name ;
+   task_t *task ;
+   unsigned int period, budget, work ;
+} periodic_t ;
+
+task_t Ctrl1, Ctrl2, Hog1, Hog2 ;
+
+periodic_t P1 = { "    Ctrl1", &Ctrl1, 20, 6, 4 } ;
+periodic_t P2 = { "        Ctrl2", &Ctrl2, 50, 15, 10 } ;
+
+// simula um processamento pesado
+int hardwork (int n)
+{
+   int i, j, soma ;
+
+   soma = 0 ;
+   for (i=0; i<n; i++)
+      for (j=0; j<n; j++)
+         soma += j ;
+   return (soma) ;
+}
+
+// ocupa o processador por ms milissegundos
+void spin (unsigned int ms)
+{
+   unsigned int start = systime () ;
+
+   while (systime () - start < ms) ;
+}
+
+// corpo das tarefas periodicas
+void Periodic (void * arg)
+{
+   periodic_t *p = (periodic_t *) arg ;
+   int i ;
+
+   printf ("%s: inicio em %4d ms (periodo %d, orcamento %d)\n", p->name,
+           systime(), p->period, p->budget) ;
+   for (i=0; i<JOBS; i++)
+   {
+      spin (p->work) ;
+      task_wait_period () ;
+   }
+   printf ("%s: fim    em %4d ms, %d jobs, %d deadlines perdidos\n", p->name,
+           systime(), JOBS, p->task->uiDeadlineMisses) ;
+   task_exit (0) ;
+}
+
+// corpo das tarefas normais
+void Hog (void * arg)
+{
+   printf ("%s: inicio em %4d ms\n", (char *) arg, systime()) ;
+   hardwork (WORKLOAD) ;
+   printf ("%s: fim    em %4d ms\n", (char *) arg, systime()) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   task_create (&Hog1, Hog, "            Hog1") ;
+   task_create (&Hog2, Hog, "                Hog2") ;
+
+   task_create (&Ctrl1, Periodic, &P1) ;
+   if (task_set_deadline (&Ctrl1, P1.period, P1.budget) < 0)
+      printf ("main: Ctrl1 nao foi admitida\n") ;
+
+   task_create (&Ctrl2, Periodic, &P2) ;
+   if (task_set_deadline (&Ctrl2, P2.period, P2.budget) < 0)
+      printf ("main: Ctrl2 nao foi admitida\n") ;
+
+   // a utilizacao ja esta em 60%, essa tarefa nao pode ser admitida
+   if (task_set_deadline (&Hog1, 10, 5) < 0)
+      printf ("main: Hog1 nao foi admitida (esperado)\n") ;
+
+   task_join (&Ctrl1) ;
+   task_join (&Ctrl2) ;
+   task_join (&Hog1) ;
+   task_join (&Hog2) ;
+
+   printf ("main: fim\n");
+   exit (0) ;
+}
@@ -0,0 +1,108 @@
+// PingPongOS - PingPong Operating System
+
+// Teste do caminho rapido dos semaforos e mutexes - mede o tempo de um par
+// requisitar/liberar sem disputa pelo caminho rapido e pelas operacoes da
+// biblioteca, e depois disputa o mutex e o semaforo entre varias tarefas
+// preemptadas no meio das operacoes, conferindo as somas.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define ROUNDS     1000000
+#define NUM_TASKS  4
+#define NUM_STEPS  200000
+
+task_t Adder[NUM_TASKS] ;
+semaphore_t s ;
+mutex_t m ;
+long mutexSum = 0, semSum = 0 ;
+
+// incrementa as somas protegidas pelo mutex e pelo semaforo; a cada tanto
+// cede o processador dentro da secao critica, forcando a disputa
+void AdderBody (void * arg)
+{
+   long i, value ;
+
+   for (i=0; i<NUM_STEPS; i++)
+   {
+      mutex_lock_fast (&m) ;
+      value = mutexSum ;
+      if (i % 1000 == 0)
+         task_yield () ;
+      mutexSum = value + 1 ;
+      mutex_unlock_fast (&m) ;
+
+      sem_down_fast (&s) ;
+      value = semSum ;
+      if (i % 1000 == 500)
+         task_yield () ;
+      semSum = value + 1 ;
+      sem_up_fast (&s) ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   unsigned long long t ;
+   int i ;
+
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   mutex_create (&m) ;
+   sem_create (&s, 1) ;
+
+   // sem disputa
+   t = systime_ns () ;
+   for (i=0; i<ROUNDS; i++)
+   {
+      mutex_lock_fast (&m) ;
+      mutex_unlock_fast (&m) ;
+   }
+   printf ("mutex, caminho rapido:  %llu ns\n", (systime_ns () - t) / ROUNDS) ;
+
+   t = systime_ns () ;
+   for (i=0; i<ROUNDS; i++)
+   {
+      mutex_lock (&m) ;
+      mutex_unlock (&m) ;
+   }
+   printf ("mutex, biblioteca:      %llu ns\n", (systime_ns () - t) / ROUNDS) ;
+
+   t = systime_ns () ;
+   for (i=0; i<ROUNDS; i++)
+   {
+      sem_down_fast (&s) ;
+      sem_up_fast (&s) ;
+   }
+   printf ("semaforo, caminho rapido: %llu ns\n", (systime_ns () - t) / ROUNDS) ;
+
+   t = systime_ns () ;
+   for (i=0; i<ROUNDS; i++)
+   {
+      sem_down (&s) ;
+      sem_up (&s) ;
+   }
+   printf ("semaforo, biblioteca:     %llu ns\n", (systime_ns () - t) / ROUNDS) ;
+
+   for (i=0; i<NUM_TASKS; i++)
+   {
+      task_create (&Adder[i], AdderBody, "Adder") ;
+      task_setprio (&Adder[i], i - NUM_TASKS / 2) ;
+   }
+   for (i=0; i<NUM_TASKS; i++)
+      task_join (&Adder[i]) ;
+
+   printf ("main: somas %ld e %ld, esperado %d\n", mutexSum, semSum, NUM_TASKS * NUM_STEPS) ;
+   if (mutexSum != NUM_TASKS * NUM_STEPS || semSum != NUM_TASKS * NUM_STEPS)
+      printf ("main: FALHOU\n") ;
+   else
+      printf ("main: ok\n") ;
+
+   printf ("main: fim\n");
+   task_exit (0) ;
+   exit (0) ;
+}
@@ -0,0 +1,59 @@
+// PingPongOS - PingPong Operating System
+
+// Teste dos grupos de tarefas - o grupo A tem tres tarefas e o grupo B uma
+// so, com o mesmo peso; o grupo C tem o limite de 10 ms a cada 100 ms
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define DURATION 3000
+
+task_group_t GroupA, GroupB, GroupC ;
+task_t A1, A2, A3, B1, C1 ;
+
+// ocupa o processador ate o fim do teste
+void Body (void * arg)
+{
+   while (systime () < DURATION) ;
+   printf ("%s: fim em %4d ms\n", (char *) arg, systime ()) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   task_group_create (&GroupA, 0) ;
+   task_group_create (&GroupB, 0) ;
+   task_group_create (&GroupC, 0) ;
+   if (task_group_set_quota (&GroupC, 10, 100) < 0)
+      printf ("main: cota do grupo C nao foi aceita\n") ;
+   if (task_group_set_quota (&GroupC, 200, 100) < 0)
+      printf ("main: cota maior que o periodo recusada (esperado)\n") ;
+
+   task_create (&A1, Body, "    A1") ;
+   task_create (&A2, Body, "    A2") ;
+   task_create (&A3, Body, "    A3") ;
+   task_create (&B1, Body, "        B1") ;
+   task_create (&C1, Body, "            C1") ;
+
+   task_group_attach (&GroupA, &A1) ;
+   task_group_attach (&GroupA, &A2) ;
+   task_group_attach (&GroupA, &A3) ;
+   task_group_attach (&GroupB, &B1) ;
+   task_group_attach (&GroupC, &C1) ;
+
+   task_join (&A1) ;
+   task_join (&A2) ;
+   task_join (&A3) ;
+   task_join (&B1) ;
+   task_join (&C1) ;
+
+   printf ("main: grupo A usou %d ms, grupo B %d ms, grupo C %d ms\n",
+           GroupA.usage, GroupB.usage, GroupC.usage) ;
+   printf ("main: fim\n");
+   exit (0) ;
+}
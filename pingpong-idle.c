@@ -0,0 +1,78 @@
+// PingPongOS - PingPong Operating System
+
+// Teste da ociosidade - as tarefas passam quase todo o tempo dormindo; sem
+// tarefa pronta o processo deve ficar bloqueado, e nao girando no dispatcher,
+// entao o tempo de CPU do processo fica bem abaixo do tempo decorrido.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ppos.h"
+
+#define NUM_TASKS  3
+#define NUM_SLEEPS 10
+#define SLEEP_MS   20
+
+task_t Sleeper[NUM_TASKS] ;
+semaphore_t s ;
+
+// dorme varias vezes, passando o semaforo adiante a cada despertar
+void SleeperBody (void * arg)
+{
+   int i ;
+
+   for (i=0; i<NUM_SLEEPS; i++)
+   {
+      task_sleep_us (SLEEP_MS * 1000) ;
+      sem_down (&s) ;
+      sem_up (&s) ;
+   }
+   task_exit (0) ;
+}
+
+// tempo de CPU usado pelo processo, em nanossegundos
+unsigned long long cpu_ns ()
+{
+   struct timespec t ;
+
+   clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &t) ;
+   return t.tv_sec * 1000000000ULL + t.tv_nsec ;
+}
+
+int main (int argc, char *argv[])
+{
+   unsigned long long wall, cpu, idle ;
+   int i ;
+
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   sem_create (&s, 1) ;
+
+   wall = systime_ns () ;
+   cpu  = cpu_ns () ;
+   idle = systime_idle_ns () ;
+
+   for (i=0; i<NUM_TASKS; i++)
+      task_create (&Sleeper[i], SleeperBody, "Sleeper") ;
+   for (i=0; i<NUM_TASKS; i++)
+      task_join (&Sleeper[i]) ;
+
+   wall = systime_ns () - wall ;
+   cpu  = cpu_ns () - cpu ;
+   idle = systime_idle_ns () - idle ;
+
+   printf ("main: decorrido %llu ms, CPU %llu ms, ocioso %llu ms\n",
+           wall / 1000000, cpu / 1000000, idle / 1000000) ;
+
+   // o processo deve ter passado a maior parte do tempo bloqueado
+   if (2 * cpu > wall || 2 * idle < wall)
+      printf ("main: FALHOU, o processo nao ficou ocioso\n") ;
+   else
+      printf ("main: ok\n") ;
+
+   printf ("main: fim\n");
+   task_exit (0) ;
+   exit (0) ;
+}
@@ -0,0 +1,148 @@
+// PingPongOS - PingPong Operating System
+
+// Teste das tarefas leves - um milhao de tarefas leves cedem o processador
+// e terminam; depois produtores e consumidores leves trocam mensagens com
+// uma tarefa normal por uma fila de mensagens; por fim tarefas leves esperam
+// um semaforo que eh destruido.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "ppos.h"
+
+#define MANY      1000000
+#define PRODUCERS 1000
+#define CONSUMERS 900
+#define WAITERS   10
+
+ltask_t Many[MANY], Producers[PRODUCERS], Consumers[CONSUMERS], Waiters[WAITERS] ;
+int values[PRODUCERS], received[CONSUMERS] ;
+task_t Consumer ;
+mqueue_t queue ;
+semaphore_t done, gate ;
+int finished, failed, waiting ;
+long sum ;
+
+// terminam na segunda ativacao
+void ManyEnd (ltask_t *task, void *arg)
+{
+   if (++finished == MANY)
+      sem_up (&done) ;
+}
+
+void ManyBody (ltask_t *task, void *arg)
+{
+   ltask_yield (task, ManyEnd) ;
+}
+
+// produtores leves: enviam seu numero e terminam
+void ProducerEnd (ltask_t *task, void *arg)
+{
+   if (task->result < 0)
+      failed++ ;
+}
+
+void ProducerBody (ltask_t *task, void *arg)
+{
+   ltask_mqueue_send (task, &queue, arg, ProducerEnd) ;
+}
+
+// consumidores leves: somam o valor recebido e terminam
+void ConsumerEnd (ltask_t *task, void *arg)
+{
+   if (task->result < 0)
+      failed++ ;
+   else
+      sum += *(int *) arg ;
+   if (++finished == CONSUMERS)
+      sem_up (&done) ;
+}
+
+void ConsumerBody (ltask_t *task, void *arg)
+{
+   ltask_mqueue_recv (task, &queue, arg, ConsumerEnd) ;
+}
+
+// consumidor normal: recebe as mensagens que os leves nao recebem
+void ConsumerTask (void *arg)
+{
+   int i, value ;
+
+   for (i=0; i<PRODUCERS-CONSUMERS; i++)
+   {
+      mqueue_recv (&queue, &value) ;
+      sum += value ;
+   }
+   task_exit (0) ;
+}
+
+// esperam um semaforo que nunca eh liberado
+void WaiterEnd (ltask_t *task, void *arg)
+{
+   if (task->result < 0)
+      failed++ ;
+}
+
+void WaiterBody (ltask_t *task, void *arg)
+{
+   if (ltask_sem_down (task, &gate, WaiterEnd) == 0)
+      waiting++ ;
+}
+
+int main (int argc, char *argv[])
+{
+   struct timespec start, end ;
+   struct rusage usage ;
+   double secs ;
+   long expected = 0 ;
+   int i ;
+
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+   sem_create (&done, 0) ;
+
+   clock_gettime (CLOCK_MONOTONIC, &start) ;
+   for (i=0; i<MANY; i++)
+      ltask_create (&Many[i], ManyBody, NULL) ;
+   sem_down (&done) ;
+   clock_gettime (CLOCK_MONOTONIC, &end) ;
+
+   getrusage (RUSAGE_SELF, &usage) ;
+   secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9 ;
+   printf ("main: %d tarefas leves em %.3f s, %.0f tarefas/s, memoria residente maxima %ld KB\n",
+           MANY, secs, MANY / secs, usage.ru_maxrss) ;
+
+   // produtores e consumidores leves, mais um consumidor normal
+   finished = 0 ;
+   mqueue_create (&queue, 5, sizeof (int)) ;
+   task_create (&Consumer, ConsumerTask, NULL) ;
+   for (i=0; i<CONSUMERS; i++)
+      ltask_create (&Consumers[i], ConsumerBody, &received[i]) ;
+   for (i=0; i<PRODUCERS; i++)
+   {
+      values[i] = i ;
+      expected += i ;
+      ltask_create (&Producers[i], ProducerBody, &values[i]) ;
+   }
+   sem_down (&done) ;
+   task_join (&Consumer) ;
+   printf ("main: soma recebida %ld, esperada %ld, %d falhas\n", sum, expected, failed) ;
+
+   // a destruicao do semaforo libera os que esperam com erro
+   sem_create (&gate, 0) ;
+   for (i=0; i<WAITERS; i++)
+      ltask_create (&Waiters[i], WaiterBody, NULL) ;
+   while (waiting < WAITERS)
+      task_yield () ;
+   sem_destroy (&gate) ;
+   while (failed < WAITERS)
+      task_yield () ;
+   printf ("main: %d tarefas leves liberadas com erro\n", failed) ;
+
+   mqueue_destroy (&queue) ;
+   printf ("main: fim\n");
+   task_exit (0) ;
+   exit (0) ;
+}
@@ -15,7 +15,7 @@
 /*
  * Buffer
  * Note que essas funções não controlam o sistema produtor-consumidor.
- * Essa é a função dos semáforos.
+ * Essa é a função do mutex e das variáveis de condição.
  */
 
 typedef struct Buffer {
@@ -51,9 +51,9 @@ int bufferRetrieve(Buffer* buffer) {
 task_t produtor[NUM_PRODUTORES];
 task_t consumidor[NUM_CONSUMIDORES];
 
-semaphore_t sBuffer;
-semaphore_t sItem;
-semaphore_t sVaga;
+mutex_t mBuffer;
+cond_t cItem;
+cond_t cVaga;
 
 Buffer b;
 
@@ -66,13 +66,16 @@ void taskProdutor(void* id) {
         task_sleep(1);
         item = random() % 100;
         
-        sem_down(&sVaga);
-        sem_down(&sBuffer);
+        mutex_lock(&mBuffer);
+        
+        while (b.i == TAM_BUFFER) {
+            cond_wait(&cVaga, &mBuffer);
+        }
         
         bufferPlace(&b, item);
         
-        sem_up(&sBuffer);
-        sem_up(&sItem);
+        cond_signal(&cItem);
+        mutex_unlock(&mBuffer);
         
         printf("p%d produziu %d\n", num, item);
     }
@@ -86,13 +89,16 @@ void taskConsumidor(void* id) {
     int item;
     
     while (1) {
-        sem_down(&sItem);
-        sem_down(&sBuffer);
+        mutex_lock(&mBuffer);
+        
+        while (b.i == 0) {
+            cond_wait(&cItem, &mBuffer);
+        }
         
         item = bufferRetrieve(&b);
         
-        sem_up(&sBuffer);
-        sem_up(&sVaga);
+        cond_signal(&cVaga);
+        mutex_unlock(&mBuffer);
         
         printf("                    c%d consumiu %d\n", num, item);
         task_sleep(1);
@@ -108,9 +114,9 @@ int main (int argc, char *argv[]) {
     
     bufferInit(&b);
     
-    sem_create(&sBuffer, 1);
-    sem_create(&sItem, 0);
-    sem_create(&sVaga, 5);
+    mutex_create(&mBuffer);
+    cond_create(&cItem);
+    cond_create(&cVaga);
     
     for (i = 0; i < NUM_PRODUTORES; ++i) {
         task_create(&(produtor[i]), taskProdutor, &(produtor[i].id));
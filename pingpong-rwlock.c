@@ -0,0 +1,159 @@
+// PingPongOS - PingPong Operating System
+
+// Teste do rwlock - leitores cedem o processador no meio da leitura de uma
+// tabela que os escritores reescrevem por inteiro; nenhum leitor pode ver a
+// tabela pela metade, os leitores devem ler juntos e os escritores devem
+// terminar mesmo com leitores chegando o tempo todo, nos dois modos. Liberar
+// o rwlock sem te-lo deve falhar sem mexer nos leitores.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define NUM_READERS 6
+#define NUM_WRITERS 2
+#define NUM_WRITES  20
+#define TABLE_SIZE  8
+
+task_t Reader[NUM_READERS], Writer[NUM_WRITERS], Intruder ;
+rwlock_t rw ;
+int table[TABLE_SIZE] ;
+int writersDone, reading, maxReading, torn, intruded, failures = 0 ;
+long reads ;
+
+// le a tabela enquanto houver escritor trabalhando, cedendo no meio
+void ReaderBody (void * arg)
+{
+   int i, first ;
+
+   while (writersDone < NUM_WRITERS)
+   {
+      rwlock_rdlock (&rw) ;
+      reading++ ;
+      if (reading > maxReading)
+         maxReading = reading ;
+      first = table[0] ;
+      for (i=1; i<TABLE_SIZE; i++)
+      {
+         task_yield () ;
+         if (table[i] != first)
+            torn++ ;
+      }
+      reading-- ;
+      reads++ ;
+      rwlock_unlock (&rw) ;
+   }
+   task_exit (0) ;
+}
+
+// reescreve a tabela inteira, cedendo no meio
+void WriterBody (void * arg)
+{
+   int i, j ;
+
+   for (j=0; j<NUM_WRITES; j++)
+   {
+      rwlock_wrlock (&rw) ;
+      if (reading)
+         torn++ ;
+      for (i=0; i<TABLE_SIZE; i++)
+      {
+         table[i]++ ;
+         task_yield () ;
+      }
+      rwlock_unlock (&rw) ;
+      task_yield () ;
+   }
+   writersDone++ ;
+   task_exit (0) ;
+}
+
+// libera o rwlock sem te-lo obtido
+void IntruderBody (void * arg)
+{
+   intruded = rwlock_unlock (&rw) ;
+   task_exit (0) ;
+}
+
+// liberar sem ter o rwlock nao pode abrir a vez de um escritor
+void unlock_without_lock ()
+{
+   rwlock_create (&rw, PPOS_RWLOCK_PREFER_WRITER) ;
+
+   if (rwlock_unlock (&rw) != -1)
+   {
+      printf ("unlock sem lock: FALHOU, rwlock livre foi liberado\n") ;
+      failures++ ;
+   }
+
+   rwlock_rdlock (&rw) ;
+   task_create (&Intruder, IntruderBody, NULL) ;
+   task_join (&Intruder) ;
+   if (intruded != -1 || rw.countReaders != 1)
+   {
+      printf ("unlock sem lock: FALHOU, %d leitores depois do intruso\n", rw.countReaders) ;
+      failures++ ;
+   }
+
+   if (rwlock_unlock (&rw) != 0 || rwlock_unlock (&rw) != -1 || rw.countReaders != 0)
+   {
+      printf ("unlock sem lock: FALHOU, leitor liberou duas vezes\n") ;
+      failures++ ;
+   }
+   else
+      printf ("unlock sem lock: recusado\n") ;
+
+   rwlock_destroy (&rw) ;
+}
+
+void run (int mode, char *name)
+{
+   unsigned long long t ;
+   int i ;
+
+   rwlock_create (&rw, mode) ;
+   writersDone = reading = maxReading = torn = 0 ;
+   reads = 0 ;
+
+   t = systime_ns () ;
+   for (i=0; i<NUM_READERS; i++)
+      task_create (&Reader[i], ReaderBody, NULL) ;
+   for (i=0; i<NUM_WRITERS; i++)
+      task_create (&Writer[i], WriterBody, NULL) ;
+   for (i=0; i<NUM_WRITERS; i++)
+      task_join (&Writer[i]) ;
+   for (i=0; i<NUM_READERS; i++)
+      task_join (&Reader[i]) ;
+   t = systime_ns () - t ;
+
+   printf ("%s: %d escritas, %ld leituras, ate %d leitores juntos, %llu ms\n",
+           name, NUM_WRITERS * NUM_WRITES, reads, maxReading, t / 1000000) ;
+
+   if (torn || maxReading < 2 || table[0] != NUM_WRITERS * NUM_WRITES * (mode + 1))
+   {
+      printf ("%s: FALHOU, %d leituras inconsistentes\n", name, torn) ;
+      failures++ ;
+   }
+
+   rwlock_destroy (&rw) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int i ;
+
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   for (i=0; i<TABLE_SIZE; i++)
+      table[i] = 0 ;
+
+   run (PPOS_RWLOCK_PREFER_WRITER, "escritores primeiro") ;
+   run (PPOS_RWLOCK_PREFER_READER, "leitores primeiro") ;
+   unlock_without_lock () ;
+
+   printf ("main: fim, %d falhas\n", failures);
+   task_exit (0) ;
+   exit (0) ;
+}
@@ -0,0 +1,73 @@
+// PingPongOS - PingPong Operating System
+
+// Teste da troca de prioridade de tarefas prontas na politica fair - as
+// tarefas sao criadas com prioridade 0 e trocadas enquanto estao na fila de
+// prontas; a de prioridade -10 deve ficar com a maior parte de cada rodada,
+// mas nenhuma rajada pode passar de uma rodada
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define DURATION 2000
+#define LATENCY 48      // rodada da politica fair, em ms
+
+task_t A, B, C ;
+unsigned int burst[3] ;
+
+// ocupa o processador ate o fim do teste, medindo a maior rajada seguida
+void Body (void * arg)
+{
+   int i = *(int *) arg ;
+   unsigned int start, last, now ;
+
+   start = last = systime () ;
+   while ((now = systime ()) < DURATION)
+   {
+      // um salto no relogio indica que outra tarefa executou
+      if (now > last + 1)
+         start = now ;
+      if (now - start > burst[i])
+         burst[i] = now - start ;
+      last = now ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   static int ids[3] = {0, 1, 2} ;
+   int i ;
+
+   printf ("main: inicio\n");
+
+   setenv ("PPOS_SCHED_POLICY", "fair", 1) ;
+   ppos_init () ;
+
+   task_create (&A, Body, &ids[0]) ;
+   task_create (&B, Body, &ids[1]) ;
+   task_create (&C, Body, &ids[2]) ;
+
+   // as tres estao prontas: cada troca move a tarefa entre as estruturas
+   for (i = 0; i < 10; i++)
+   {
+      task_setprio (&A, (i % 2) ? 19 : -19) ;
+      task_setprio (&C, (i % 2) ? -19 : 19) ;
+   }
+   task_setprio (&A, -10) ;
+   task_setprio (&B, 0) ;
+   task_setprio (&C, 10) ;
+
+   task_join (&A) ;
+   task_join (&B) ;
+   task_join (&C) ;
+
+   printf ("main: maiores rajadas A %d ms, B %d ms, C %d ms\n",
+           burst[0], burst[1], burst[2]) ;
+   if (burst[0] > 4 * burst[1] && burst[1] >= burst[2] && burst[0] <= LATENCY)
+      printf ("main: rajadas proporcionais aos pesos (esperado)\n") ;
+   else
+      printf ("main: rajadas fora da proporcao dos pesos\n") ;
+   printf ("main: fim\n");
+   exit (0) ;
+}
@@ -0,0 +1,107 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de desempenho da criacao de tarefas - muitas tarefas curtas sao
+// criadas e encerradas em lotes, medindo o tempo e a memoria residente.
+// Depois as mesmas tarefas sao criadas com task_create_ex, "detached" e com
+// pilhas pequenas, e uma tarefa recursiva usa uma pilha grande.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "ppos.h"
+
+#define TASKS 100000
+#define BATCH 100
+#define DEPTH 20000
+
+task_t Tasks[BATCH], Deep ;
+int finished ;
+
+// corpo das tarefas, que terminam logo
+void Body (void * arg)
+{
+   task_exit (0) ;
+}
+
+// corpo das tarefas detached, que avisam main antes de terminar
+void DetachedBody (void * arg)
+{
+   finished++ ;
+   task_exit (0) ;
+}
+
+// recursao que usa cerca de 100 bytes de pilha por nivel
+int recurse (int n)
+{
+   volatile char frame[64] ;
+
+   frame[n % 64] = 1 ;
+   return (n == 0 ? 0 : frame[n % 64] + recurse (n - 1)) ;
+}
+
+// corpo da tarefa recursiva
+void DeepBody (void * arg)
+{
+   printf ("Deep: %d niveis de recursao\n", recurse (DEPTH)) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   struct timespec start, end ;
+   struct rusage usage ;
+   task_attr_t attr ;
+   double secs ;
+   int i, j ;
+
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   clock_gettime (CLOCK_MONOTONIC, &start) ;
+   for (i=0; i<TASKS; i+=BATCH)
+   {
+      for (j=0; j<BATCH; j++)
+         task_create (&Tasks[j], Body, NULL) ;
+      for (j=0; j<BATCH; j++)
+         task_join (&Tasks[j]) ;
+   }
+   clock_gettime (CLOCK_MONOTONIC, &end) ;
+
+   getrusage (RUSAGE_SELF, &usage) ;
+   secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9 ;
+   printf ("main: %d tarefas em %.3f s, %.0f tarefas/s, memoria residente maxima %ld KB\n",
+           TASKS, secs, TASKS / secs, usage.ru_maxrss) ;
+
+   // tarefas detached, sem descritor proprio, com pilhas de 16 KB
+   task_attr_init (&attr) ;
+   attr.stacksize = 16384 ;
+   attr.detached = 1 ;
+
+   clock_gettime (CLOCK_MONOTONIC, &start) ;
+   for (i=0; i<TASKS; i+=BATCH)
+   {
+      finished = 0 ;
+      for (j=0; j<BATCH; j++)
+         task_create_ex (NULL, &attr, DetachedBody, NULL) ;
+      while (finished < BATCH)
+         task_yield () ;
+   }
+   clock_gettime (CLOCK_MONOTONIC, &end) ;
+
+   getrusage (RUSAGE_SELF, &usage) ;
+   secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9 ;
+   printf ("main: %d tarefas detached em %.3f s, %.0f tarefas/s, memoria residente maxima %ld KB\n",
+           TASKS, secs, TASKS / secs, usage.ru_maxrss) ;
+
+   // uma tarefa com pilha de 8 MB e prioridade alta
+   task_attr_init (&attr) ;
+   attr.stacksize = 8 * 1024 * 1024 ;
+   attr.prio = -10 ;
+   task_create_ex (&Deep, &attr, DeepBody, NULL) ;
+   task_join (&Deep) ;
+
+   printf ("main: fim\n");
+   exit (0) ;
+}
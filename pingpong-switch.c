@@ -0,0 +1,70 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de desempenho da troca de contexto - duas tarefas passam o
+// processador uma para a outra com task_yield. Depois muitas tarefas fazem o
+// mesmo, com descritores que nao cabem no cache.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ppos.h"
+
+#define YIELDS 1000000
+#define MANY   1000
+
+task_t Ping, Pong, Many[MANY] ;
+int yields = YIELDS ;
+
+// corpo das tarefas
+void Body (void * arg)
+{
+   int i ;
+
+   for (i=0; i<yields; i++)
+      task_yield () ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   struct timespec start, end ;
+   double secs, yields_total ;
+   int i ;
+
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   task_create (&Ping, Body, "Ping") ;
+   task_create (&Pong, Body, "Pong") ;
+
+   clock_gettime (CLOCK_MONOTONIC, &start) ;
+   task_join (&Ping) ;
+   task_join (&Pong) ;
+   clock_gettime (CLOCK_MONOTONIC, &end) ;
+
+   // cada task_yield passa o processador para a outra tarefa, diretamente ou
+   // via despachante
+   secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9 ;
+   yields_total = 2.0 * YIELDS ;
+   printf ("main: %.0f task_yield em %.3f s, %.0f ns por task_yield\n",
+           yields_total, secs, secs * 1e9 / yields_total) ;
+
+   // cada tarefa cede o processador ate completar YIELDS trocas no total
+   yields = YIELDS / MANY ;
+   for (i=0; i<MANY; i++)
+      task_create (&Many[i], Body, NULL) ;
+
+   clock_gettime (CLOCK_MONOTONIC, &start) ;
+   for (i=0; i<MANY; i++)
+      task_join (&Many[i]) ;
+   clock_gettime (CLOCK_MONOTONIC, &end) ;
+
+   secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9 ;
+   yields_total = YIELDS ;
+   printf ("main: %d tarefas, %.0f task_yield em %.3f s, %.0f ns por task_yield\n",
+           MANY, yields_total, secs, secs * 1e9 / yields_total) ;
+
+   printf ("main: fim\n");
+   exit (0) ;
+}
@@ -0,0 +1,158 @@
+// PingPongOS - PingPong Operating System
+
+// Teste das operacoes com prazo - cada primitiva bloqueante eh chamada em
+// uma versao *_timed que deve expirar e em outra que deve ser atendida antes
+// do prazo; as que expiram medem o atraso em relacao ao prazo.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ppos.h"
+
+#define WAIT_MS 20
+
+task_t Holder, Sleeper, Waiter ;
+semaphore_t s ;
+mutex_t m ;
+barrier_t b ;
+mqueue_t q ;
+
+int failures = 0 ;
+
+// confere o resultado de uma operacao e, se expirou, o atraso do despertar
+void check (char *name, int result, int expected, unsigned long long deadline)
+{
+   unsigned long long now = systime_ns () ;
+
+   if (result != expected)
+   {
+      printf ("%-22s: FALHOU, retornou %d em vez de %d\n", name, result, expected) ;
+      failures++ ;
+   }
+   else if (result == PPOS_ETIMEDOUT && now < deadline)
+   {
+      printf ("%-22s: FALHOU, expirou %llu us antes do prazo\n", name, (deadline - now) / 1000) ;
+      failures++ ;
+   }
+   else if (result == PPOS_ETIMEDOUT)
+      printf ("%-22s: expirou, atraso %llu us\n", name, (now - deadline) / 1000) ;
+   else
+      printf ("%-22s: ok\n", name) ;
+}
+
+// confere o conteudo de uma mensagem recebida
+void check_msg (int msg, int expected)
+{
+   if (msg != expected)
+   {
+      printf ("mensagem errada: %d em vez de %d\n", msg, expected) ;
+      failures++ ;
+   }
+}
+
+unsigned long long after_ms (int ms)
+{
+   return systime_ns () + ms * 1000000ULL ;
+}
+
+// segura o mutex enquanto dorme
+void HolderBody (void * arg)
+{
+   mutex_lock (&m) ;
+   task_sleep_us (8 * WAIT_MS * 1000) ;
+   mutex_unlock (&m) ;
+   task_exit (0) ;
+}
+
+// dorme e depois libera o semaforo, a barreira e a fila
+void SleeperBody (void * arg)
+{
+   int msg = 7 ;
+
+   task_sleep_us (WAIT_MS / 2 * 1000) ;
+   sem_up (&s) ;
+   barrier_join (&b) ;
+   mqueue_send (&q, &msg) ;
+   task_exit (42) ;
+}
+
+void WaiterBody (void * arg)
+{
+   unsigned long long deadline ;
+   int msg = 0, i ;
+
+   // nada chega antes do prazo
+   deadline = after_ms (WAIT_MS) ;
+   check ("sem_down_timed", sem_down_timed (&s, deadline), PPOS_ETIMEDOUT, deadline) ;
+   deadline = after_ms (WAIT_MS) ;
+   check ("mutex_lock_timed", mutex_lock_timed (&m, deadline), PPOS_ETIMEDOUT, deadline) ;
+   deadline = after_ms (WAIT_MS) ;
+   check ("barrier_join_timed", barrier_join_timed (&b, deadline), PPOS_ETIMEDOUT, deadline) ;
+   deadline = after_ms (WAIT_MS) ;
+   check ("mqueue_recv_timed", mqueue_recv_timed (&q, &msg, deadline), PPOS_ETIMEDOUT, deadline) ;
+   deadline = after_ms (WAIT_MS) ;
+   check ("task_join_timed", task_join_timed (&Holder, deadline), PPOS_ETIMEDOUT, deadline) ;
+
+   // enche a fila, a proxima mensagem nao cabe
+   for (i=0; i<2; i++)
+      mqueue_send (&q, &i) ;
+   deadline = after_ms (WAIT_MS) ;
+   check ("mqueue_send_timed", mqueue_send_timed (&q, &i, deadline), PPOS_ETIMEDOUT, deadline) ;
+   for (i=0; i<2; i++)
+      mqueue_recv (&q, &msg) ;
+
+   // as operacoes da biblioteca e as *_timed se alternam na mesma fila
+   deadline = after_ms (WAIT_MS) ;
+   for (i=1; i<=2; i++)
+      mqueue_send (&q, &i) ;
+   check ("recv_timed (misto)", mqueue_recv_timed (&q, &msg, deadline), 0, deadline) ;
+   check_msg (msg, 1) ;
+   i = 3 ;
+   mqueue_send (&q, &i) ;
+   for (i=2; i<=3; i++)
+   {
+      check ("recv_timed (misto)", mqueue_recv_timed (&q, &msg, deadline), 0, deadline) ;
+      check_msg (msg, i) ;
+   }
+
+   // um prazo que ja passou nao bloqueia
+   deadline = systime_ns () ;
+   check ("sem_down_timed (0)", sem_down_timed (&s, deadline), PPOS_ETIMEDOUT, deadline) ;
+
+   // o Sleeper atende antes do prazo; as esperas que expiraram nao deixaram
+   // rastro no semaforo nem na barreira
+   task_create (&Sleeper, SleeperBody, "Sleeper") ;
+   deadline = after_ms (10 * WAIT_MS) ;
+   check ("sem_down_timed", sem_down_timed (&s, deadline), 0, deadline) ;
+   check ("barrier_join_timed", barrier_join_timed (&b, deadline), 0, deadline) ;
+   check ("mqueue_recv_timed", mqueue_recv_timed (&q, &msg, deadline), 0, deadline) ;
+   check ("task_join_timed", task_join_timed (&Sleeper, deadline), 42, deadline) ;
+   deadline = after_ms (10 * WAIT_MS) ;
+   check ("mutex_lock_timed", mutex_lock_timed (&m, deadline), 0, deadline) ;
+   mutex_unlock (&m) ;
+
+   check_msg (msg, 7) ;
+
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   sem_create (&s, 0) ;
+   mutex_create (&m) ;
+   barrier_create (&b, 2) ;
+   mqueue_create (&q, 2, sizeof (int)) ;
+
+   task_create (&Holder, HolderBody, "Holder") ;
+   task_create (&Waiter, WaiterBody, "Waiter") ;
+
+   task_join (&Waiter) ;
+   task_join (&Holder) ;
+
+   printf ("main: fim, %d falhas\n", failures);
+   task_exit (0) ;
+   exit (0) ;
+}
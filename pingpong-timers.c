@@ -0,0 +1,88 @@
+// PingPongOS - PingPong Operating System
+
+// Teste de desempenho dos temporizadores - com cada vez mais tarefas
+// dormindo, duas tarefas passam o processador uma para a outra com
+// task_yield; depois as tarefas que dormem sao acordadas antes da hora com
+// task_resume.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ppos.h"
+
+#define YIELDS   100000
+#define SLEEPERS 20000
+
+task_t Ping, Pong, Sleepers[SLEEPERS] ;
+int counts[] = {10, 100, 1000, 10000, SLEEPERS} ;
+int asleep ;
+
+// corpo das tarefas que dormem: uma hora, ou ate serem acordadas
+void SleeperBody (void * arg)
+{
+   asleep++ ;
+   task_sleep (3600) ;
+   task_exit (0) ;
+}
+
+// corpo das tarefas que cedem o processador
+void YieldBody (void * arg)
+{
+   int i ;
+
+   for (i=0; i<YIELDS; i++)
+      task_yield () ;
+   task_exit (0) ;
+}
+
+double elapsed (struct timespec *start, struct timespec *end)
+{
+   return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9 ;
+}
+
+int main (int argc, char *argv[])
+{
+   struct timespec start, end ;
+   double yield_ns, resume_ns ;
+   int sleepers, i, j ;
+
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   // o custo por operacao deve ser o mesmo com 10 ou 20 mil tarefas dormindo
+   for (j=0; j<sizeof (counts) / sizeof (counts[0]); j++)
+   {
+      sleepers = counts[j] ;
+      asleep = 0 ;
+      for (i=0; i<sleepers; i++)
+         task_create (&Sleepers[i], SleeperBody, NULL) ;
+      while (asleep < sleepers)
+         task_yield () ;
+
+      task_create (&Ping, YieldBody, "Ping") ;
+      task_create (&Pong, YieldBody, "Pong") ;
+
+      clock_gettime (CLOCK_MONOTONIC, &start) ;
+      task_join (&Ping) ;
+      task_join (&Pong) ;
+      clock_gettime (CLOCK_MONOTONIC, &end) ;
+      yield_ns = elapsed (&start, &end) * 1e9 / (2.0 * YIELDS) ;
+
+      // acorda as tarefas antes da hora
+      clock_gettime (CLOCK_MONOTONIC, &start) ;
+      for (i=0; i<sleepers; i++)
+         task_resume (&Sleepers[i]) ;
+      clock_gettime (CLOCK_MONOTONIC, &end) ;
+      resume_ns = elapsed (&start, &end) * 1e9 / sleepers ;
+
+      for (i=0; i<sleepers; i++)
+         task_join (&Sleepers[i]) ;
+
+      printf ("main: %5d tarefas dormindo, %.0f ns por task_yield, %.0f ns por task_resume\n",
+              sleepers, yield_ns, resume_ns) ;
+   }
+
+   printf ("main: fim\n");
+   exit (0) ;
+}
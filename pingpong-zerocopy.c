@@ -0,0 +1,135 @@
+// PingPongOS - PingPong Operating System
+
+// Teste do envio e recebimento sem copia - um produtor passa mensagens de
+// 4 KB a um consumidor pelas operacoes da biblioteca, pelo mqueue_send_ring
+// e mqueue_recv_ring e por mqueue_reserve/commit e mqueue_peek/release, conferindo
+// a ordem das mensagens; mensagens de 4 bytes sem copia mostram o custo do
+// escalonador sozinho. Por fim confere que uma fila nao aceita operacoes das
+// duas disposicoes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ppos.h"
+
+#define NUM_MSGS   20000
+#define MAX_MSGS   8
+#define MSG_SIZE   4096
+
+// como passar as mensagens
+#define MODE_LIBRARY  0
+#define MODE_COPY     1
+#define MODE_INPLACE  2
+
+task_t Prod, Cons ;
+mqueue_t queue ;
+int mode, size, failures = 0 ;
+char msg[2][MSG_SIZE] ;
+
+// cada mensagem leva o numero dela no inicio e no fim
+void ProdBody (void * arg)
+{
+   int i, *slot ;
+
+   for (i=0; i<NUM_MSGS; i++)
+   {
+      if (mode == MODE_INPLACE)
+         slot = mqueue_reserve (&queue) ;
+      else
+         slot = (int *) msg[0] ;
+
+      slot[0] = i ;
+      slot[size / sizeof (int) - 1] = i ;
+
+      if (mode == MODE_LIBRARY)
+         mqueue_send (&queue, slot) ;
+      else if (mode == MODE_COPY)
+         mqueue_send_ring (&queue, slot) ;
+      else
+         mqueue_commit (&queue) ;
+   }
+   task_exit (0) ;
+}
+
+void ConsBody (void * arg)
+{
+   int i, *slot ;
+
+   for (i=0; i<NUM_MSGS; i++)
+   {
+      slot = (int *) msg[1] ;
+
+      if (mode == MODE_LIBRARY)
+         mqueue_recv (&queue, slot) ;
+      else if (mode == MODE_COPY)
+         mqueue_recv_ring (&queue, slot) ;
+      else
+         slot = mqueue_peek (&queue) ;
+
+      if (slot[0] != i || slot[size / sizeof (int) - 1] != i)
+         failures++ ;
+
+      if (mode == MODE_INPLACE)
+         mqueue_release (&queue) ;
+   }
+   task_exit (0) ;
+}
+
+void run (int m, int s, char *name)
+{
+   unsigned long long t ;
+
+   mode = m ;
+   size = s ;
+   mqueue_create (&queue, MAX_MSGS, size) ;
+
+   t = systime_ns () ;
+   task_create (&Prod, ProdBody, NULL) ;
+   task_create (&Cons, ConsBody, NULL) ;
+   task_join (&Prod) ;
+   task_join (&Cons) ;
+   t = systime_ns () - t ;
+
+   printf ("%s: %d mensagens de %d bytes em %llu ms, %llu ns cada\n",
+           name, NUM_MSGS, size, t / 1000000, t / NUM_MSGS) ;
+
+   mqueue_destroy (&queue) ;
+}
+
+// a primeira operacao fixa a disposicao da fila, as da outra sao recusadas
+void layouts (void)
+{
+   int msg = 1 ;
+
+   mqueue_create (&queue, MAX_MSGS, sizeof (int)) ;
+   mqueue_send (&queue, &msg) ;
+   if (mqueue_reserve (&queue) != NULL || mqueue_send_ring (&queue, &msg) != -1)
+      failures++ ;
+   mqueue_destroy (&queue) ;
+
+   mqueue_create (&queue, MAX_MSGS, sizeof (int)) ;
+   mqueue_send_ring (&queue, &msg) ;
+   if (mqueue_send (&queue, &msg) != -1 || mqueue_recv (&queue, &msg) != -1 ||
+       mqueue_recv_timed (&queue, &msg, 0) != -1 || mqueue_msgs (&queue) != 1)
+      failures++ ;
+   mqueue_destroy (&queue) ;
+
+   printf ("disposicoes misturadas: recusadas\n") ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("main: inicio\n");
+
+   ppos_init () ;
+
+   run (MODE_LIBRARY, MSG_SIZE, "biblioteca") ;
+   run (MODE_COPY,    MSG_SIZE, "anel") ;
+   run (MODE_INPLACE, MSG_SIZE, "sem copia") ;
+   run (MODE_INPLACE, sizeof (int), "sem copia") ;
+   layouts () ;
+
+   printf ("main: fim, %d falhas\n", failures);
+   task_exit (0) ;
+   exit (0) ;
+}
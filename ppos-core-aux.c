@@ -1,25 +1,217 @@
 #include "ppos.h"
 #include "ppos-core-globals.h"
 #include "ppos_disk.h"
+#include <assert.h>
+#include <setjmp.h>
 #include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
 
 #define UNIX_MAX_PRIO 20
 #define UNIX_MIN_PRIO -20
 #define UNIX_AGING_FACTOR -1
+#define UNIX_PRIO_LEVELS (UNIX_MAX_PRIO - UNIX_MIN_PRIO + 1)
 
-#define TIMER_STARTING_SHOT_S 1
 #define TIMER_PERIOD_uS 1000
 #define DEFAULT_TASK_TICKS 40
 
+#define CLOCK_NS_PER_US 1000ULL
+#define CLOCK_NS_PER_MS 1000000ULL
+
+// Tickless mode: longest the one-shot timer is programmed for, so systime()
+// never lags the monotonic clock by more than this while a task runs alone
+#define TICKLESS_MAX_DEFER_MS 50
+
+// Idle: longest the periodic timer is stretched for while no task is ready
+#define IDLE_MAX_SLEEP_MS 50
+
 #define SIGALRM 14
 
+// Task states as written by the core library
+#define TASK_STATE_READY 'r'
+#define TASK_STATE_SUSPENDED 's'
+#define TASK_STATE_EXECUTING 'e'
+#define TASK_STATE_TERMINATED 'x'
+
+// Mutex value: free and held as the core library writes them, and held with
+// tasks waiting, which keeps the owner from releasing it with a single swap
+#define MUTEX_FREE 1
+#define MUTEX_HELD 0
+#define MUTEX_CONTENDED 2
+
+// Adaptive quantum: bounds of the per-task quantum and how many levels of
+// dynamic priority an I/O bound task gains when it wakes up
+#define QUANTUM_MIN_TICKS 5
+#define QUANTUM_MAX_TICKS 160
+#define IO_WAKE_BOOST 5
+
+// Real-time class: processor utilization the admitted tasks may add up to,
+// in parts per million
+#define EDF_MAX_UTILIZATION 1000000UL
+
+// Initial amount of slots in the ready heap, it doubles when full
+#define READY_HEAP_INITIAL_SIZE 64
+
+// Amount of FIFOs in the bitmap run queues, one bit of the occupancy word each
+#define BITMAP_SLOTS 64
+
+// Fair scheduling: weight of a priority 0 task, period in which every ready
+// task should run once, shortest slice given to a task and how much virtual
+// runtime (in microseconds) a task waking up may be behind the others
+#define FAIR_NICE_0_WEIGHT 1024
+#define FAIR_LATENCY_TICKS 48
+#define FAIR_MIN_SLICE_TICKS 2
+#define FAIR_WAKEUP_CREDIT_uS 6000
+
+// Task groups: weight of a group created with 0 shares, which is also the
+// weight of the root group
+#define GROUP_DEFAULT_SHARES 1024
+
+// Message queues: layout of the messages, taken by the first operation used
+// on the queue. The core library keeps them linear, the zero-copy operations
+// in a ring
+#define MQUEUE_LAYOUT_NONE 0
+#define MQUEUE_LAYOUT_LINEAR 1
+#define MQUEUE_LAYOUT_RING 2
+
+// Native context switch: swapcontext() is replaced by a routine that only
+// saves the callee-saved registers and the stack pointer, skipping the signal
+// mask syscall. Building with -DPPOS_UCONTEXT_SWITCH keeps the glibc one.
+#if defined(__x86_64__) && defined(__linux__) && !defined(PPOS_UCONTEXT_SWITCH)
+#define PPOS_NATIVE_SWITCH
+#endif
+
+// Offsets of the ucontext_t fields the native switch uses, the same ones the
+// glibc setcontext() reads
+#define UCTX_R8 40
+#define UCTX_R9 48
+#define UCTX_R12 72
+#define UCTX_R13 80
+#define UCTX_R14 88
+#define UCTX_R15 96
+#define UCTX_RDI 104
+#define UCTX_RSI 112
+#define UCTX_RBP 120
+#define UCTX_RBX 128
+#define UCTX_RDX 136
+#define UCTX_RCX 152
+#define UCTX_RSP 160
+#define UCTX_RIP 168
+#define UCTX_FPREGS 224
+#define UCTX_FPREGS_MEM 424
+#define UCTX_MXCSR 448
+
+#define UCTX_GREG(off) (((off) - UCTX_R8) / 8)
+
+// Offset of the context in task_t, as laid out by the core library
+#define TASK_CONTEXT 24
+
+// Direct switch: a yielding task runs scheduler() itself and the native
+// switch goes straight to the chosen task instead of to the dispatcher, which
+// is left for idle time and for waking the sleeping tasks up. Building with
+// -DPPOS_DISPATCHER_YIELD keeps every yield going through the dispatcher.
+#if defined(PPOS_NATIVE_SWITCH) && !defined(PPOS_DISPATCHER_YIELD)
+#define PPOS_DIRECT_SWITCH
+#endif
+
+// Deferred preemption: the timer handlers never switch tasks themselves. When
+// the running task may be preempted, the handler makes the interrupted
+// context resume in a trampoline that saves every register, calls task_yield()
+// and returns to where the task was. Building with -DPPOS_HANDLER_PREEMPT
+// keeps the task_yield() inside the handlers.
+#if defined(__x86_64__) && defined(__linux__) && !defined(PPOS_HANDLER_PREEMPT)
+#define PPOS_RETURN_PREEMPT
+#endif
+
+// Bytes below the stack pointer the interrupted code may be using, which the
+// trampoline leaves alone
+#define RED_ZONE_SIZE 128
+
+// Offset of the 64 bytes header of the XSAVE area, which XRSTOR expects to
+// be zeroed apart from what XSAVE writes
+#define XSAVE_HEADER 512
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+// Task stacks: mmap'ed with a guard page below each one, committed lazily by
+// the kernel and recycled through a pool that keeps up to STACK_POOL_MAX free
+// stacks. Building with -DPPOS_MALLOC_STACKS keeps them malloc'ed, as the core
+// library does. Either way a task only moves to another stack on x86-64 Linux,
+// where the body makecontext() set can be read back from the context.
+#if defined(__x86_64__) && defined(__linux__)
+#define PPOS_STACK_MOVE
+#ifndef PPOS_MALLOC_STACKS
+#define PPOS_STACK_POOL
+#endif
+#endif
+
+#define STACK_POOL_MAX 256
+
+// Smallest stack task_create_ex() gives, room for the frames of the timer
+// handler and of a task switch on top of the task own frames
+#define STACK_MIN_SIZE 16384
+
+// Most scheduling policies sched_register() accepts, built-in ones included
+#define SCHED_MAX_POLICIES 16
+
+// Light tasks: buckets of the table of light tasks waiting on semaphores,
+// indexed by the semaphore address
+#define LTASK_WAIT_BUCKETS 64
+
+// Timing wheel of the sleeping tasks: 256 slots of 1 ms on the first level,
+// then 64 slots on each level above, every slot as long as the whole level
+// below it. Wake ups further than WHEEL_SPAN_MS, about 18 hours, wait in the
+// last slot and are placed again as the wheel turns.
+#define WHEEL_L0_BITS 8
+#define WHEEL_LN_BITS 6
+#define WHEEL_LEVELS 4
+#define WHEEL_L0_SLOTS (1 << WHEEL_L0_BITS)
+#define WHEEL_LN_SLOTS (1 << WHEEL_LN_BITS)
+#define WHEEL_SLOTS (WHEEL_L0_SLOTS + (WHEEL_LEVELS - 1) * WHEEL_LN_SLOTS)
+#define WHEEL_SPAN_MS (1U << (WHEEL_L0_BITS + (WHEEL_LEVELS - 1) * WHEEL_LN_BITS))
+
+// Longest a timed wait is kept in the timing wheel, about 12 days, so its
+// wake up time stays far from the wrap of systemTime
+#define DEADLINE_MAX_DELAY_MS (1U << 30)
+
+// Policy used when PPOS_SCHED_POLICY is not set in the environment
+#define SCHED_DEFAULT_POLICY "aging"
+
 // ****************************************************************************
 // Coloque aqui as suas modificações, p.ex. includes, defines variáveis,
 // estruturas e funções
 
+// GLOBAL VARIABLES DEFINITIONS ===============================================
+
+// The core library only reserves room for the task_t it was compiled with,
+// these definitions give main and the dispatcher room for the fields below
+// the "outros campos" comment in ppos_data.h
+task_t _taskMain;
+task_t _taskDisp;
+
+// The library IPC primitives read iPreemptCheck at a fixed offset, and the
+// fields the scheduler reads at each decision must share one cache line
+_Static_assert(offsetof(task_t, iPreemptCheck) == 0x408, "task_t layout");
+_Static_assert(offsetof(task_t, iStaticPrio) % 64 == 0, "task_t layout");
+_Static_assert(offsetof(task_t, uiExecTicks) - offsetof(task_t, iStaticPrio) <= 64,
+               "task_t layout");
+
 // STATIC VARIABLES DECLARATIONS ==============================================
 
+// Registered scheduling policies and the one scheduler() is using
+static sched_policy_t *apstPolicies[SCHED_MAX_POLICIES];
+static int iPoliciesQty = 0;
+static sched_policy_t *pstPolicy = NULL;
+
 // Structure to handle interruptions fired by the timer
 static struct sigaction stAction;
 
@@ -28,614 +220,5923 @@ static struct itimerval stTimer;
 
 static unsigned int uiTaskStartingTick = 0;
 
-// STATIC FUNCTIONS DECLARATIONS ==============================================
+// Ticks left before the running task is preempted
+static int iTaskTicksQty = DEFAULT_TASK_TICKS;
+
+// Set when the running task is preempted for using its whole quantum
+static char cQuantumExpired = 0;
+
+// Set when a more urgent real-time task became ready, the running task is
+// preempted on the next tick
+static char cPreemptPending = 0;
+
+// Deferred preemption: nesting depth of the critical sections of this file,
+// set when the running task owes a preemption it is given at the next safe
+// point, set from a task_yield() call until its switch and set while the
+// signal return trampoline is armed
+static volatile unsigned int uiPreemptDepth = 0;
+static volatile char cReschedPending = 0;
+static volatile char cYielding = 0;
+static volatile char cTrampolineArmed = 0;
+
+// Check of iPreemptCheck at start up: set while a library primitive is probed
+// and where before_task_yield() leaves the probe if the primitive yields
+static volatile char cYieldProbing = 0;
+static jmp_buf stYieldProbe;
+
+#ifdef PPOS_RETURN_PREEMPT
+// Where the preempted task resumes after the trampoline, and the bytes XSAVE
+// needs for the state components the kernel enabled, 0 without XSAVE
+static volatile greg_t llPreemptedRip __attribute__((used)) = 0;
+static unsigned long ulXsaveSize __attribute__((used)) = 0;
+#endif
+
+// Tickless mode: the timer is programmed for the next event only, systemTime
+// follows the monotonic clock and the ticks in between are delivered to the
+// policy at once
+static char cTickless = 0;
+static unsigned int uiLastTick = 0;
+static unsigned int uiTimerExpiry = 0;
+
+// Monotonic clock at ppos_init(), the origin of systime_ns(). With the
+// periodic timer systemTime only starts at the first tick, whose clock and
+// tick count give how many ticks the signals that coalesced stand for. A
+// sleep ending between two ticks has the timer shot at ullShotNs, and the
+// shot makes the sentinel of the timing wheel due without being a tick.
+static struct timespec stClockStart;
+static unsigned long long ullFirstTickNs = 0;
+static unsigned int uiFirstTick = 0;
+static volatile unsigned long long ullShotNs = 0;
+static volatile char cShotDue = 0;
+
+// Idle: time the process spent blocked while no task was ready, in total and
+// in ticks since the dispatcher last started running, which are not charged
+// to it
+static unsigned long long ullIdleNs = 0;
+static unsigned int uiIdleTicks = 0;
+
+// Nice style weight of each priority, from UNIX_MIN_PRIO to UNIX_MAX_PRIO.
+// Each level gets around 25% less processor than the one before it.
+static const unsigned int auiFairWeights[UNIX_PRIO_LEVELS] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+    9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+    1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45, 36, 29, 23, 18, 15,
+    12};
 
 /**
- * @brief Gets the task with the highest priority in the list
+ * @brief Node of the ready heap
  *
- * @param pstFirstTask The start of the list
- * @return task_t* Pointer to the highest priority task
+ * The key is the dynamic priority the task had when it entered the heap,
+ * shifted by the aging epoch of that moment, so it never has to be updated
+ * while the task waits.
  */
-static task_t *getHighestPrioTaks(task_t *pstFirstTask);
+typedef struct
+{
+    task_t *pstTask;
+    long long llKey;
+    unsigned long ulSeq;
+} ST_HeapNode;
 
 /**
- * @brief A handler for the implemented tick system
- *
- * For each 20 ticks fired, this function calls scheduler() to decide the next
- * task to be executed
+ * @brief Binary min-heap with every task of readyQueue
  *
- * @param signum An ID for the interruption
+ * Nodes are stored from index 1 on, so a task_t with iHeapIdx 0 is not in the
+ * heap. llEpoch counts the scheduler picks, which is how many aging steps
+ * were applied to the tasks waiting in the heap. The fair policy uses the
+ * same heap, keyed by the virtual runtime of the tasks.
  */
-static void tickHandler(int signum);
+typedef struct
+{
+    ST_HeapNode *pstNodes;
+    int iSize;
+    int iCapacity;
+    long long llEpoch;
+    unsigned long ulSeq;
+} ST_ReadyHeap;
+
 
 /**
- * @brief Updates the tasks metric parameters when preempting
+ * @brief Run queues with one circular FIFO per priority level
  *
- * @param pstPreviousTask Pointer to the previous task
- * @param pstNextTask     Pointer to the next task
+ * Level l holds the ready tasks whose aged priority is UNIX_MIN_PRIO + l, and
+ * it lives in the slot (iBase + l) % BITMAP_SLOTS. Each scheduler pick ages
+ * every waiting task by rotating iBase, so the whole aging costs a single
+ * splice of the top level into the next one. Bit n of ullBitmap is set when
+ * slot n is not empty.
  */
-static void metricsHandler(task_t *pstPreviousTask, task_t *pstNextTask);
+typedef struct
+{
+    queue_t astSlots[BITMAP_SLOTS];
+    unsigned long long ullBitmap;
+    int iBase;
+} ST_BitmapQueues;
 
 /**
- * @brief A function that prints the information of the task being exited
+ * @brief Every structure the built-in policies use to keep ready tasks
  *
- * It uses global variables and pointers to decide what informations from which tasks to print.
+ * Each task group has one of these, the real-time class only uses the one of
+ * the root group.
  */
-static void printTaskInfo(void);
-
-// ****************************************************************************
-
-void before_ppos_init()
+typedef struct
 {
-    // Interrupt handler initialization
-    stAction.sa_handler = tickHandler;
-    sigemptyset(&stAction.sa_mask);
-    stAction.sa_flags = 0;
+    ST_ReadyHeap stHeap;
+    ST_BitmapQueues stBitmap;
 
-    if (sigaction(SIGALRM, &stAction, 0) < 0)
-    {
-        perror("Sigaction error: ");
-        exit(1);
-    }
+    // Fair policy: virtual runtime floor and weight of the ready tasks
+    unsigned long long ullMinVRuntime;
+    unsigned long long ullReadyWeight;
 
-    // Timer initialization
-    stTimer.it_value.tv_sec = TIMER_STARTING_SHOT_S;
-    stTimer.it_value.tv_usec = 0;
-    stTimer.it_interval.tv_sec = 0;
-    stTimer.it_interval.tv_usec = TIMER_PERIOD_uS;
+    // Real-time class: ready tasks keyed by absolute deadline, tasks waiting
+    // for their next period keyed by release time and the utilization
+    // already admitted, in parts per million
+    ST_ReadyHeap stEdfHeap;
+    ST_ReadyHeap stEdfReleases;
+    unsigned long ulEdfUtilization;
+} ST_RunQueue;
 
-    if (setitimer(0, &stTimer, 0) < 0)
-    {
-        perror("Setitimer error: ");
-        exit(1);
-    }
+static ST_RunQueue stRunQueue;
 
-#ifdef DEBUG
-    printf("\ninit - BEFORE");
-#endif
-}
+// Task groups: the root one, where main and the first tasks are, the list of
+// every group and the run queue the built-in policies are working on, which
+// is the one of the group being scheduled. Group picks raise the virtual
+// runtime floor of the groups.
+static task_group_t stRootGroup = {GROUP_DEFAULT_SHARES, 0, 0, 0, 0, 0, 0, 0, &stRunQueue, NULL};
+static task_group_t *pstGroups = &stRootGroup;
+static ST_RunQueue *pstCurRunQueue = &stRunQueue;
+static unsigned long long ullMinGroupVRuntime = 0;
 
-void after_ppos_init()
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ninit - AFTER");
+#ifdef PPOS_DIRECT_SWITCH
+// Task chosen by the yielding task, from the decision until the native switch
+// has moved to its stack. The switch reads it in place of the dispatcher.
+// cDirectCharged is set while the yielding task has already been accounted
+// for, as if it had switched to the dispatcher.
+static task_t *volatile pstDirectNext __attribute__((used)) = NULL;
+static volatile char cDirectCharged = 0;
 #endif
-}
 
-void before_task_create(task_t *task)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_create - BEFORE - [%d]", task->id);
-#endif
-}
+// Attributes of the task_create_ex() call in progress, NULL for task_create()
+static const task_attr_t *pstCreateAttr = NULL;
 
-void after_task_create(task_t *task)
-{
-    // put your customization here
-    task->uiExecTicks = systemTime;
-#ifdef DEBUG
-    printf("\ntask_create - AFTER - [%d]", task->id);
-#endif
-}
+// The task_t of the last task that exited, when it was allocated by
+// task_create_ex(), which is used until the dispatcher takes over
+static task_t *pstExitedTcb = NULL;
 
-void before_task_exit () {
-#ifdef DEBUG
-    printf("\ntask_exit - BEFORE - [%d]", taskExec->id);
+#ifdef PPOS_STACK_POOL
+// Task stacks: free ones ready to be reused and their sizes, and the stack of
+// the last task that exited, which runs on it until the dispatcher takes over
+static void *apvStackPool[STACK_POOL_MAX];
+static size_t aszStackPool[STACK_POOL_MAX];
+static int iStackPoolQty = 0;
+static void *pvExitedStack = NULL;
+static size_t szExitedStack = 0;
 #endif
-}
 
-void after_task_exit()
+/**
+ * @brief FIFO of light tasks waiting on the semaphores of one bucket
+ *
+ * semaphore_t can't have a field for them, mqueue_t embeds its semaphores,
+ * three of them at offsets the core library relies on.
+ */
+typedef struct
 {
-    // put your customization here
+    ltask_t *pstHead;
+    ltask_t *pstTail;
+} ST_LightWaitList;
 
-    // Updates how many ticks the task has taken to be fully executed
-    taskExec->uiExecTicks = (systemTime - taskExec->uiExecTicks);
+// Light tasks: the system task they run on, NULL when there is none, and
+// whether it is suspended for lack of ready ones, their ready FIFO, the ones
+// waiting on semaphores, the one running and whether it asked to continue.
+// ulLightTasks counts the light tasks that haven't finished yet.
+static task_t *pstLightRunner = NULL;
+static task_t *pstLightIdleQueue = NULL;
+static char cLightRunnerIdle = 0;
+static ltask_t *pstLightReadyHead = NULL;
+static ltask_t *pstLightReadyTail = NULL;
+static ST_LightWaitList astLightWaits[LTASK_WAIT_BUCKETS];
+static unsigned long ulLightWaiters = 0;
+static ltask_t *pstLightCurrent = NULL;
+static char cLightContinued = 0;
+static unsigned long ulLightTasks = 0;
 
-    printTaskInfo();
+// Timing wheel: its slots, one occupancy bit per slot, the first time it
+// hasn't processed yet and how many tasks it holds. The dispatcher only
+// wakes the tasks of sleepQueue up, so the sentinel sleeps there until the
+// next event of the wheel, and its wake up drains the expired slots.
+static queue_t astWheelSlots[WHEEL_SLOTS];
+static unsigned long long aullWheelBitmap[WHEEL_SLOTS / 64];
+static unsigned int uiWheelNow = 0;
+static unsigned int uiWheelTasks = 0;
+static task_t stWheelSentinel;
 
-#ifdef DEBUG
-    printf("\ntask_exit - AFTER- [%d]", taskExec->id);
-#endif
-}
+// STATIC FUNCTIONS DECLARATIONS ==============================================
 
-void before_task_switch(task_t *task)
-{
-    // put your customization here
-    metricsHandler(taskExec, task);
-#ifdef DEBUG
-    printf("\ntask_switch - BEFORE - [%d -> %d]", taskExec->id, task->id);
-#endif
-}
+/**
+ * @brief Inserts a task that has just entered readyQueue in the structures of
+ * its class: the deadline heap for real-time tasks, the policy for the others
+ *
+ * @param pstTask Pointer to the task
+ */
+static void readyEnqueue(task_t *pstTask);
 
-void after_task_switch(task_t *task)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_switch - AFTER - [%d -> %d]", taskExec->id, task->id);
-#endif
-}
+/**
+ * @brief Removes a task from the structures of its class
+ *
+ * @param pstTask Pointer to the task
+ */
+static void readyDequeue(task_t *pstTask);
 
-void before_task_yield()
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_yield - BEFORE - [%d]", taskExec->id);
-#endif
-}
-void after_task_yield()
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_yield - AFTER - [%d]", taskExec->id);
-#endif
-}
+/**
+ * @brief Counts a tick of the running task against its real-time budget or
+ * the quantum of the policy
+ *
+ * @param pstTask Pointer to the running task
+ * @return int    1 if the task must be preempted, 0 if not
+ */
+static int taskTick(task_t *pstTask);
 
-void before_task_suspend(task_t *task)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_suspend - BEFORE - [%d]", task->id);
-#endif
-}
+/**
+ * @brief Real-time class: takes the ready task with the earliest deadline out
+ *
+ * @return task_t* Pointer to the chosen task, NULL if there is none
+ */
+static task_t *edfPick(void);
 
-void after_task_suspend(task_t *task)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_suspend - AFTER - [%d]", task->id);
-#endif
-}
+/**
+ * @brief Real-time class: charges a tick to the budget of the current job
+ *
+ * A job that overruns its budget goes on with the deadline of the next
+ * period, so it can't take the processor reserved to the other real-time
+ * tasks.
+ *
+ * @param pstTask Pointer to the running task
+ * @return int    1 when the budget is over, 0 if not
+ */
+static int edfTick(task_t *pstTask);
 
-void before_task_resume(task_t *task)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_resume - BEFORE - [%d]", task->id);
-#endif
-}
+/**
+ * @brief Asks for the preemption of the running task when a real-time task
+ * reaches its release time, so the dispatcher wakes it up right away
+ */
+static void edfCheckRelease(void);
 
-void after_task_resume(task_t *task)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_resume - AFTER - [%d]", task->id);
-#endif
-}
+/**
+ * @brief Asks for the preemption of the running task if a real-time task
+ * that has just become ready is more urgent
+ *
+ * @param pstTask Pointer to the task that became ready
+ */
+static void edfCheckPreempt(task_t *pstTask);
 
-void before_task_sleep()
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_sleep - BEFORE - [%d]", taskExec->id);
-#endif
-}
+/**
+ * @brief Priority inheritance: gets the priority a task should run with, the
+ * highest between its own and the ones of the tasks waiting for the mutexes
+ * it holds
+ *
+ * @param pstTask Pointer to the task
+ * @return int    Effective priority
+ */
+static int piEffectivePrio(task_t *pstTask);
 
-void after_task_sleep()
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_sleep - AFTER - [%d]", taskExec->id);
+/**
+ * @brief Priority inheritance: changes the effective priority of a task,
+ * moving it in the ready structures when it is waiting there
+ *
+ * @param pstTask Pointer to the task
+ * @param iPrio   New effective priority
+ */
+static void piSetPrio(task_t *pstTask, int iPrio);
+
+/**
+ * @brief Priority inheritance: a task is about to block on a mutex, so its
+ * priority is passed to the owner, to the owner of the mutex the owner is
+ * blocked on, and so on
+ *
+ * @param pstTask  Pointer to the task, the running one or a condition waiter
+ * @param pstMutex Pointer to the mutex
+ */
+static void piBoostChain(task_t *pstTask, mutex_t *pstMutex);
+
+/**
+ * @brief Priority inheritance: takes a mutex out of the list of mutexes held
+ * by a task
+ *
+ * @param pstTask  Pointer to the task
+ * @param pstMutex Pointer to the mutex
+ */
+static void piHeldRemove(task_t *pstTask, mutex_t *pstMutex);
+
+/**
+ * @brief Releases the stack and the task_t of the last task that exited, which
+ * is no longer running on them
+ */
+static void taskReclaim(void);
+
+#ifdef PPOS_DIRECT_SWITCH
+/**
+ * @brief Direct switch: makes the decision the dispatcher would make for the
+ * task that is yielding, when it has nothing else to do
+ *
+ * The chosen task leaves readyQueue here and task_switch(), called by
+ * task_yield() for the dispatcher, goes to it instead.
+ */
+static void directSwitchPrepare(void);
 #endif
-}
 
-int before_task_join(task_t *task)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_join - BEFORE - [%d]", taskExec->id);
+#ifdef PPOS_STACK_MOVE
+/**
+ * @brief Moves a task that has just been created from the stack the core
+ * library allocated to one from the stack pool, or to a malloc'ed one of
+ * another size
+ *
+ * @param pstTask Pointer to the task
+ * @param szSize  Size of the stack, in bytes
+ */
+static void stackReplace(task_t *pstTask, size_t szSize);
+
+/**
+ * @brief Takes a stack of the given size from the pool, mapping a new one
+ * when there is none
+ *
+ * @param szSize Size of the stack, a multiple of the page size
+ * @return void* Lowest address of the stack, above its guard page
+ */
+static void *stackAlloc(size_t szSize);
 #endif
-    return 0;
-}
 
-int after_task_join(task_t *task)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\ntask_join - AFTER - [%d]", taskExec->id);
+#ifdef PPOS_STACK_POOL
+/**
+ * @brief Gives a stack back to the pool, or unmaps it when the pool is full
+ *
+ * @param pvStack Lowest address of the stack
+ * @param szSize  Size of the stack
+ */
+static void stackRelease(void *pvStack, size_t szSize);
 #endif
-    return 0;
-}
+
+/**
+ * @brief Light tasks: body of the system task they run on. It runs the ready
+ * ones in FIFO order, suspends itself while there is none and exits once
+ * every light task has finished
+ *
+ * @param pvArg Not used
+ */
+static void lightRunnerBody(void *pvArg);
+
+/**
+ * @brief Light tasks: appends a light task to the ready FIFO, waking the
+ * system task they run on up
+ *
+ * @param pstTask Pointer to the light task
+ * @param pfnFunc Function it continues in
+ */
+static void lightReady(ltask_t *pstTask, void (*pfnFunc)(ltask_t *, void *));
+
+/**
+ * @brief Light tasks: tells if a light task is the running one and hasn't
+ * asked to continue yet, so it may ask now
+ *
+ * @param pstTask Pointer to the light task
+ * @return int    1 if it may, 0 if not
+ */
+static int lightMayContinue(ltask_t *pstTask);
+
+/**
+ * @brief Light tasks: takes a unit of a semaphore for a light task, or puts
+ * the light task to wait for one
+ *
+ * task->result is set to -1 when the semaphore is not active.
+ *
+ * @param pstTask Pointer to the light task
+ * @param pstSem  Pointer to the semaphore
+ * @param pfnFunc Function the light task continues in after waiting
+ * @return int    1 when the light task doesn't have to wait, 0 if it waits
+ */
+static int lightSemWait(ltask_t *pstTask, semaphore_t *pstSem, void (*pfnFunc)(ltask_t *, void *));
+
+/**
+ * @brief Light tasks: takes the first light task waiting on a semaphore out
+ * of the wait table
+ *
+ * @param pstSem    Pointer to the semaphore
+ * @return ltask_t* Pointer to the light task, NULL if there is none
+ */
+static ltask_t *lightWaitTake(semaphore_t *pstSem);
+
+/**
+ * @brief Message queues: gives the queue the layout of an operation family
+ * if it has none yet, the first operation used on a queue decides it
+ *
+ * @param pstQueue Pointer to the queue
+ * @param ucLayout MQUEUE_LAYOUT_LINEAR or MQUEUE_LAYOUT_RING
+ * @return int     0 if the queue has that layout, -1 if it has the other one
+ */
+static int mqueueLayout(mqueue_t *pstQueue, unsigned char ucLayout);
+
+/**
+ * @brief Message queues: delivers the message written to the slot after the
+ * last one and ends the send
+ *
+ * @param pstQueue Pointer to the queue
+ */
+static void mqueueCommit(mqueue_t *pstQueue);
+
+/**
+ * @brief Message queues: frees the slot of the oldest message and ends the
+ * receive
+ *
+ * @param pstQueue Pointer to the queue
+ */
+static void mqueueRelease(mqueue_t *pstQueue);
+
+/**
+ * @brief Light tasks: steps of ltask_mqueue_send(), run once the light task
+ * got a free slot and once it got the buffer
+ *
+ * @param pstTask Pointer to the light task
+ * @param pvArg   Argument of the light task
+ */
+static void lightSendSlot(ltask_t *pstTask, void *pvArg);
+static void lightSendCopy(ltask_t *pstTask, void *pvArg);
+
+/**
+ * @brief Light tasks: steps of ltask_mqueue_recv(), run once the light task
+ * got a message and once it got the buffer
+ *
+ * @param pstTask Pointer to the light task
+ * @param pvArg   Argument of the light task
+ */
+static void lightRecvItem(ltask_t *pstTask, void *pvArg);
+static void lightRecvCopy(ltask_t *pstTask, void *pvArg);
+
+/**
+ * @brief Task groups: points the built-in policies to the run queue of the
+ * group of a task
+ *
+ * @param pstTask Pointer to the task
+ */
+static void groupSelect(task_t *pstTask);
+
+/**
+ * @brief Task groups: starts a new quota period when the current one is over
+ *
+ * @param pstGroup Pointer to the group
+ */
+static void groupRefill(task_group_t *pstGroup);
+
+/**
+ * @brief Task groups: takes the next task out of the group with the smallest
+ * virtual runtime, skipping the groups whose quota is over
+ *
+ * @param pcThrottled Set to 1 if some group has ready tasks but no quota left
+ * @return task_t*    Pointer to the chosen task, NULL if there is none
+ */
+static task_t *groupPick(char *pcThrottled);
+
+/**
+ * @brief Task groups: checks the quota of the group of the running task
+ *
+ * @param pstTask Pointer to the running task
+ * @return int    1 when the quota is over, 0 if not
+ */
+static int groupTick(task_t *pstTask);
+
+/**
+ * @brief Task groups: charges the ticks a task has just run to its group
+ *
+ * @param pstTask     Pointer to the task
+ * @param uiUsedTicks Ticks the task has just run
+ */
+static void groupCharge(task_t *pstTask, unsigned int uiUsedTicks);
+
+/**
+ * @brief Task groups: gets how long until the quota of the task about to run
+ * is over or the quota of a throttled group is refilled
+ *
+ * @param pstNextTask   Pointer to the task about to run
+ * @return unsigned int Milliseconds until the next event, at most
+ *                      TICKLESS_MAX_DEFER_MS
+ */
+static unsigned int groupNextEvent(task_t *pstNextTask);
+
+/**
+ * @brief Tells if the policy in use is a built-in one, the only ones that
+ * keep a run queue per task group
+ *
+ * @return int 1 if it is built-in, 0 if not
+ */
+static int schedGroupAware(void);
+
+/**
+ * @brief Finds a registered scheduling policy
+ *
+ * @param pcName          Name of the policy
+ * @return sched_policy_t* Pointer to the policy, NULL if there is none
+ */
+static sched_policy_t *schedFind(const char *pcName);
+
+/**
+ * @brief Aging policy over the ready heap: inserts a task that has just
+ * entered readyQueue
+ *
+ * @param pstTask Pointer to the task
+ */
+static void agingHeapEnqueue(task_t *pstTask);
+
+/**
+ * @brief Aging policy over the ready heap: removes a task, bringing the
+ * aging it got while waiting to its dynamic priority
+ *
+ * @param pstTask Pointer to the task
+ */
+static void agingHeapDequeue(task_t *pstTask);
+
+/**
+ * @brief Aging policy over the ready heap: takes the task with the highest
+ * dynamic priority out, aging the others
+ *
+ * @return task_t* Pointer to the chosen task, NULL if there is none
+ */
+static task_t *agingHeapPick(void);
+
+/**
+ * @brief Aging policy over the bitmap run queues: inserts a task that has
+ * just entered readyQueue
+ *
+ * @param pstTask Pointer to the task
+ */
+static void agingBitmapEnqueue(task_t *pstTask);
+
+/**
+ * @brief Aging policy over the bitmap run queues: removes a task
+ *
+ * @param pstTask Pointer to the task
+ */
+static void agingBitmapDequeue(task_t *pstTask);
+
+/**
+ * @brief Aging policy over the bitmap run queues: takes the first task of the
+ * highest level out, aging the others
+ *
+ * @return task_t* Pointer to the chosen task, NULL if there is none
+ */
+static task_t *agingBitmapPick(void);
+
+/**
+ * @brief Fair policy: inserts a task in the heap keyed by virtual runtime
+ *
+ * @param pstTask Pointer to the task
+ */
+static void fairEnqueue(task_t *pstTask);
+
+/**
+ * @brief Fair policy: removes a task from the heap
+ *
+ * @param pstTask Pointer to the task
+ */
+static void fairDequeue(task_t *pstTask);
+
+/**
+ * @brief Fair policy: takes the task with the smallest virtual runtime out and
+ * gives it its slice
+ *
+ * @return task_t* Pointer to the chosen task, NULL if there is none
+ */
+static task_t *fairPick(void);
+
+/**
+ * @brief Fair policy: places a task waking up in virtual time
+ *
+ * It keeps its own virtual runtime, limited to FAIR_WAKEUP_CREDIT_uS behind
+ * the floor, so a long sleep doesn't turn into a long monopoly of the
+ * processor.
+ *
+ * @param pstTask Pointer to the task
+ */
+static void fairWake(task_t *pstTask);
+
+/**
+ * @brief FIFO and round-robin policies: inserts a task in the heap with the
+ * same key as the others, so they leave it in arrival order
+ *
+ * @param pstTask Pointer to the task
+ */
+static void fifoEnqueue(task_t *pstTask);
+
+/**
+ * @brief FIFO and round-robin policies: removes a task from the heap
+ *
+ * @param pstTask Pointer to the task
+ */
+static void fifoDequeue(task_t *pstTask);
+
+/**
+ * @brief FIFO and round-robin policies: takes the oldest ready task out
+ *
+ * @return task_t* Pointer to the chosen task, NULL if there is none
+ */
+static task_t *fifoPick(void);
+
+/**
+ * @brief Starts the quantum of a task that is about to run
+ *
+ * @param pstTask Pointer to the task, may be NULL
+ */
+static void quantumStart(task_t *pstTask);
+
+/**
+ * @brief Adapts the quantum of a task that is leaving the processor
+ *
+ * A task preempted at the end of its quantum is CPU bound and gets twice the
+ * quantum. A task that blocks after bursts shorter than half its quantum is
+ * I/O bound, and its quantum follows the average burst.
+ *
+ * @param pstTask     Pointer to the task
+ * @param uiUsedTicks Ticks the task has just run
+ */
+static void quantumAdapt(task_t *pstTask, unsigned int uiUsedTicks);
+
+/**
+ * @brief Counts down the quantum of the running task
+ *
+ * @param pstTask Pointer to the running task
+ * @return int    1 when the quantum is over, 0 if not
+ */
+static int quantumTick(task_t *pstTask);
+
+/**
+ * @brief Inserts a task in the ready heap
+ *
+ * @param pstHeap Pointer to the heap
+ * @param pstTask Pointer to the task
+ * @param llKey   Key of the task, the smallest one leaves the heap first
+ */
+static void readyHeapInsert(ST_ReadyHeap *pstHeap, task_t *pstTask, long long llKey);
+
+/**
+ * @brief Removes a task from the ready heap
+ *
+ * @param pstHeap Pointer to the heap
+ * @param pstTask Pointer to the task
+ * @return long long The key the task had in the heap
+ */
+static long long readyHeapRemove(ST_ReadyHeap *pstHeap, task_t *pstTask);
+
+/**
+ * @brief Tells if the heap node in iFirst must be above the one in iSecond
+ *
+ * @param pstHeap Pointer to the heap
+ * @param iFirst  Index of the first node
+ * @param iSecond Index of the second node
+ * @return int    1 if iFirst has precedence, 0 if not
+ */
+static int readyHeapPrecedes(ST_ReadyHeap *pstHeap, int iFirst, int iSecond);
+
+/**
+ * @brief Swaps two nodes of the heap, keeping the tasks indexes updated
+ *
+ * @param pstHeap Pointer to the heap
+ * @param iFirst  Index of the first node
+ * @param iSecond Index of the second node
+ */
+static void readyHeapSwap(ST_ReadyHeap *pstHeap, int iFirst, int iSecond);
+
+/**
+ * @brief Moves a node up until the heap property is restored
+ *
+ * @param pstHeap Pointer to the heap
+ * @param iIdx    Index of the node
+ */
+static void readyHeapSiftUp(ST_ReadyHeap *pstHeap, int iIdx);
+
+/**
+ * @brief Moves a node down until the heap property is restored
+ *
+ * @param pstHeap Pointer to the heap
+ * @param iIdx    Index of the node
+ */
+static void readyHeapSiftDown(ST_ReadyHeap *pstHeap, int iIdx);
+
+/**
+ * @brief Empties every FIFO of the bitmap run queues
+ *
+ * @param pstQueues Pointer to the run queues
+ */
+static void bitmapInit(ST_BitmapQueues *pstQueues);
+
+/**
+ * @brief Appends a task to the FIFO of its priority level
+ *
+ * @param pstQueues Pointer to the run queues
+ * @param pstTask   Pointer to the task
+ */
+static void bitmapInsert(ST_BitmapQueues *pstQueues, task_t *pstTask);
+
+/**
+ * @brief Takes a task out of its FIFO
+ *
+ * @param pstQueues Pointer to the run queues
+ * @param pstTask   Pointer to the task
+ */
+static void bitmapRemove(ST_BitmapQueues *pstQueues, task_t *pstTask);
+
+/**
+ * @brief Takes the first task of the highest priority level and ages the others
+ *
+ * @param pstQueues Pointer to the run queues
+ * @return task_t* Pointer to the chosen task, NULL if there is none
+ */
+static task_t *bitmapPick(ST_BitmapQueues *pstQueues);
+
+/**
+ * @brief Takes a task out of a circular queue of the core library in constant
+ * time, queue_remove() looks for it from the head first
+ *
+ * @param ppstQueue Pointer to the queue
+ * @param pstTask   Pointer to the task, which must be in the queue
+ */
+static void queueUnlink(task_t **ppstQueue, task_t *pstTask);
+
+/**
+ * @brief Empties the timing wheel and sets its sentinel up
+ */
+static void wheelInit(void);
+
+/**
+ * @brief Finds the timing wheel slot of a wake up time: the first level when
+ * it is less than 256 ms away, otherwise the level whose slots are as long as
+ * the level below it
+ *
+ * @param uiExpiry Wake up time, not before uiWheelNow
+ * @return int     Index of the slot in astWheelSlots
+ */
+static int wheelSlot(unsigned int uiExpiry);
+
+/**
+ * @brief Appends a task to the timing wheel slot of its awakeTime
+ *
+ * @param pstTask Pointer to the task
+ */
+static void wheelInsert(task_t *pstTask);
+
+/**
+ * @brief Takes a task out of the timing wheel, if it is there
+ *
+ * @param pstTask Pointer to the task
+ */
+static void wheelRemove(task_t *pstTask);
+
+/**
+ * @brief Gets the time of the next event of a non empty timing wheel: the
+ * first occupied slot of the first level or, when the levels above hold
+ * tasks, the end of the first level turn, where they cascade down
+ *
+ * @return unsigned int Time of the event, not before uiWheelNow
+ */
+static unsigned int wheelNextEvent(void);
+
+/**
+ * @brief Places the tasks of a slot of the upper levels again, closer to
+ * their wake up
+ *
+ * @param iSlot Index of the slot in astWheelSlots
+ */
+static void wheelCascade(int iSlot);
+
+/**
+ * @brief Turns the timing wheel up to a time, waking the expired tasks up,
+ * and puts the sentinel back to sleep until the next event
+ *
+ * @param uiTime System time the wheel is turned to
+ */
+static void wheelExpire(unsigned int uiTime);
+
+/**
+ * @brief Puts the sentinel of a non empty timing wheel in sleepQueue, or
+ * updates its awakeTime, to the next event of the wheel
+ */
+static void wheelArm(void);
+
+/**
+ * @brief Puts the sentinel in sleepQueue, or updates its awakeTime
+ *
+ * @param uiTime System time the dispatcher wakes the sentinel up at
+ */
+static void wheelSentinelAt(unsigned int uiTime);
+
+/**
+ * @brief Adds a task to the timing wheel, to be woken up at its awakeTime,
+ * and arms the sentinel for it
+ *
+ * @param pstTask Pointer to the task, awakeTime after systemTime
+ */
+static void wheelSchedule(task_t *pstTask);
+
+/**
+ * @brief Converts a deadline of a timed wait into the system time of the
+ * first tick at or after it
+ *
+ * @param ullDeadline   Deadline, in nanoseconds of systime_ns()
+ * @return unsigned int System time of the deadline, systemTime itself when
+ *                      it has already passed
+ */
+static unsigned int deadlineTick(unsigned long long ullDeadline);
+
+/**
+ * @brief Suspends the running task on the queue of a primitive until it is
+ * woken up or its deadline expires, in the timing wheel, whichever comes
+ * first. Called inside a critical section, which it ends.
+ *
+ * @param ppstQueue   Queue of the primitive
+ * @param ullDeadline Deadline, in nanoseconds of systime_ns()
+ * @param uiTick      System time of the deadline, after systemTime
+ * @param pvWait      The primitive, for pfnTimedOut
+ * @param pfnTimedOut Fixes the counters of the primitive once the deadline
+ *                    took the task out of its queue, NULL when there are none
+ * @return int        1 when the deadline expired, 0 otherwise
+ */
+static int timedWait(task_t **ppstQueue, unsigned long long ullDeadline, unsigned int uiTick, void *pvWait,
+                     void (*pfnTimedOut)(task_t *));
+
+/**
+ * @brief Gives back the unit a semaphore owed to a task whose wait expired
+ *
+ * @param pstTask Pointer to the task
+ */
+static void semTimedOut(task_t *pstTask);
+
+/**
+ * @brief Takes the priority a task whose wait expired lent to the mutex owner
+ * back
+ *
+ * @param pstTask Pointer to the task
+ */
+static void mutexTimedOut(task_t *pstTask);
+
+/**
+ * @brief Stops counting a task whose wait expired among the ones that arrived
+ * at a barrier
+ *
+ * @param pstTask Pointer to the task
+ */
+static void barrierTimedOut(task_t *pstTask);
+
+/**
+ * @brief Compare-and-swap on the value of a semaphore
+ *
+ * @param piWord Pointer to the value
+ * @param iOld   Value expected
+ * @param iNew   Value written if the expected one is there
+ * @return int   1 if it was written, 0 if not
+ */
+static inline __attribute__((always_inline)) int casInt(int *piWord, int iOld, int iNew);
+
+/**
+ * @brief Compare-and-swap on the value of a mutex
+ *
+ * @param pucWord Pointer to the value
+ * @param ucOld   Value expected
+ * @param ucNew   Value written if the expected one is there
+ * @return int    1 if it was written, 0 if not
+ */
+static inline __attribute__((always_inline)) int casUChar(unsigned char *pucWord, unsigned char ucOld,
+                                                        unsigned char ucNew);
+
+/**
+ * @brief Makes a task the owner of a mutex it has just been given
+ *
+ * @param pstTask  Pointer to the task
+ * @param pstMutex Pointer to the mutex
+ */
+static inline __attribute__((always_inline)) void mutexOwn(task_t *pstTask, mutex_t *pstMutex);
+
+/**
+ * @brief Wakes up a task waiting on a condition. With cMorph set, or when
+ * tasks already wait for the mutex it released, the task is moved straight
+ * to the mutex: it is handed a free mutex, or waits in the mutex queue for
+ * the unlock to hand it over. Otherwise it is only made ready, and takes the
+ * mutex back itself once it runs
+ *
+ * @param pstTask  Pointer to the task
+ * @param pstMutex Pointer to the mutex
+ * @param cMorph   Non-zero to always move the task to the mutex
+ */
+static void condRequeue(task_t *pstTask, mutex_t *pstMutex, char cMorph);
+
+/**
+ * @brief Blocks the running task in a queue of a rwlock, until it is handed
+ * the rwlock or the rwlock is destroyed
+ *
+ * @param rw        Pointer to the rwlock
+ * @param ppstQueue Queue of the readers or of the writers
+ * @return int      0 if the task got the rwlock, -1 if it was destroyed
+ */
+static int rwlockWait(rwlock_t *rw, task_t **ppstQueue);
+
+/**
+ * @brief Hands a rwlock that has just been released over to the tasks
+ * waiting for it: the next writer or every reader, as the mode prefers
+ *
+ * @param rw          Pointer to the rwlock
+ * @param cWriterLeft 1 if a writer released it, 0 if the last reader did
+ */
+static void rwlockGrant(rwlock_t *rw, char cWriterLeft);
+
+/**
+ * @brief Gets the fair share weight of a task, given its static priority
+ *
+ * @param pstTask       Pointer to the task
+ * @return unsigned int The task weight
+ */
+static unsigned int fairWeight(task_t *pstTask);
+
+/**
+ * @brief Calculates the slice of a task, sharing FAIR_LATENCY_TICKS between
+ * the ready tasks according to their weights
+ *
+ * @param pstRunQueue Pointer to the run queue
+ * @param pstTask     Pointer to the task
+ * @return int        Slice, in ticks
+ */
+static int fairSlice(ST_RunQueue *pstRunQueue, task_t *pstTask);
+
+/**
+ * @brief Unblocks the timer signal before a handler switches tasks
+ *
+ * The native switch doesn't restore the signal mask, so without this the next
+ * task would run with SIGALRM blocked until the preempted one returns from
+ * the handler.
+ */
+static void timerUnblock(void);
+
+/**
+ * @brief Opens a critical section, which may be nested in another one
+ *
+ * The running task isn't preempted until every section is closed. The core
+ * library primitives called inside one don't end it when they enable
+ * preemption back.
+ */
+static void preemptDisable(void);
+
+/**
+ * @brief Closes a critical section
+ *
+ * It never switches tasks: a preemption owed is given by the next
+ * preemptPoint() or by the library primitive the section is nested in, as it
+ * returns.
+ */
+static void preemptEnable(void);
+
+/**
+ * @brief Runs sem_up() of the core library as a task with the given
+ * iPreemptCheck and tells if the library yielded as it returned
+ *
+ * The yield is cut short in before_task_yield(), so this may run before
+ * ppos_init() has built the dispatcher.
+ *
+ * @param iCheck Value of iPreemptCheck
+ * @return int   1 if the library called task_yield(), 0 if not
+ */
+static int preemptCheckProbe(int iCheck);
+
+/**
+ * @brief Tells if the running task may be preempted right now
+ *
+ * @return int 1 if it may, 0 if not
+ */
+static int preemptAllowed(void);
+
+/**
+ * @brief Safe point: yields if the running task owes a preemption and is out
+ * of every critical section
+ */
+static void preemptPoint(void);
+
+/**
+ * @brief Asks for the preemption of the running task from a timer handler
+ *
+ * The task is preempted as the handler returns if it may be, otherwise at the
+ * next safe point.
+ *
+ * @param pvContext Context the signal interrupted
+ * @return int      1 if the task is preempted as the handler returns, 0 if not
+ */
+static int preemptRequest(void *pvContext);
+
+#ifdef PPOS_RETURN_PREEMPT
+/**
+ * @brief Finds the size of the XSAVE area, which stays 0 if the processor or
+ * the kernel don't support XSAVE
+ */
+static void trampolineInit(void);
+
+/**
+ * @brief Makes the interrupted context resume in preemptTrampoline()
+ *
+ * @param pvContext Context the signal interrupted
+ */
+static void trampolineArm(void *pvContext);
+
+/**
+ * @brief Called by preemptTrampoline() to preempt the running task
+ */
+static void preemptYield(void);
+
+/**
+ * @brief Saves every register, calls preemptYield() and restores them
+ * before returning to llPreemptedRip
+ */
+void preemptTrampoline(void);
+#endif
+
+/**
+ * @brief A handler for the implemented tick system
+ *
+ * Each signal advances systemTime up to the monotonic clock, one tick per ms,
+ * so ticks coalesced under load are not lost, and charges each tick to the
+ * running task. When its quantum ends, or a preemption is pending, the task
+ * is preempted at once if it is at a safe point, or else at the next one
+ *
+ * @param signum    An ID for the interruption
+ * @param pstInfo   Information about the signal
+ * @param pvContext Context the signal interrupted
+ */
+static void tickHandler(int signum, siginfo_t *pstInfo, void *pvContext);
+
+/**
+ * @brief Tells if the timer interrupted a task switch
+ *
+ * The core library points taskExec to the next task before swapcontext()
+ * leaves the dispatcher stack, and a pending SIGALRM is delivered right at the
+ * sigprocmask() inside it. Preempting there would save the dispatcher context
+ * as if it were the next task. The library task_yield() isn't protected
+ * either, a task preempted inside it would enter readyQueue twice.
+ *
+ * @return int 1 if the handler is running on the dispatcher stack or inside
+ * a task_yield() call, 0 if not
+ */
+static int switchInProgress(void);
+
+/**
+ * @brief A handler for the timer in tickless mode
+ *
+ * Brings the clock up to date, delivers the elapsed ticks to the policy and
+ * preempts the running task if its quantum is over, otherwise programs the
+ * timer for the next event
+ *
+ * @param signum    An ID for the interruption
+ * @param pstInfo   Information about the signal
+ * @param pvContext Context the signal interrupted
+ */
+static void ticklessHandler(int signum, siginfo_t *pstInfo, void *pvContext);
+
+/**
+ * @brief Sets systemTime to the milliseconds passed since ppos_init(), as
+ * given by systime_ns()
+ */
+static void ticklessClockUpdate(void);
+
+/**
+ * @brief Updates the clock and delivers the ticks passed since the last call
+ * to the on_tick of the policy
+ *
+ * @return int 1 if the policy asked to preempt the running task, 0 if not
+ */
+static int ticklessCatchUp(void);
+
+/**
+ * @brief Programs the one-shot timer for the next event: the end of the
+ * quantum of the task about to run or the earliest wake up in sleepQueue
+ *
+ * @param pstNextTask Pointer to the task about to run
+ */
+static void ticklessArm(task_t *pstNextTask);
+
+/**
+ * @brief Finds the earliest wake up in sleepQueue
+ *
+ * @param uiDelay       Longest delay to return, in ticks
+ * @return unsigned int Ticks until the earliest wake up, at most uiDelay, 0
+ *                      if a task is already due
+ */
+static unsigned int sleepNextEvent(unsigned int uiDelay);
+
+/**
+ * @brief Programs the periodic timer to fire at the end of a sleep that comes
+ * before its next tick, unless an earlier shot is programmed
+ *
+ * @param ullDeadline Monotonic clock the sleep ends at, in nanoseconds
+ */
+static void sleepShotArm(unsigned long long ullDeadline);
+
+/**
+ * @brief Wakes the tasks sleeping until the next tick whose clock deadline
+ * passed, and programs the shot for the earliest of the others
+ */
+static void sleepShotExpire(void);
+
+/**
+ * @brief Makes the dispatcher, left without ready tasks, wake the sentinel up
+ * on its next pass over sleepQueue, which calls idleWait()
+ */
+static void idleArm(void);
+
+/**
+ * @brief Blocks the process until a signal while no task is ready, the timer
+ * programmed for the next wake up in sleepQueue
+ */
+static void idleWait(void);
+
+/**
+ * @brief Updates the tasks metric parameters when preempting
+ *
+ * @param pstPreviousTask Pointer to the previous task
+ * @param pstNextTask     Pointer to the next task
+ */
+static void metricsHandler(task_t *pstPreviousTask, task_t *pstNextTask);
+
+/**
+ * @brief A function that prints the information of the task being exited
+ *
+ * It uses global variables and pointers to decide what informations from which tasks to print.
+ */
+static void printTaskInfo(void);
+
+// Built-in scheduling policies, registered by ppos_init()
+static sched_policy_t stAgingHeapPolicy = {"aging", agingHeapEnqueue, agingHeapDequeue,
+                                           agingHeapPick, quantumTick, NULL};
+static sched_policy_t stAgingBitmapPolicy = {"aging-bitmap", agingBitmapEnqueue, agingBitmapDequeue,
+                                             agingBitmapPick, quantumTick, NULL};
+static sched_policy_t stFairPolicy = {"fair", fairEnqueue, fairDequeue,
+                                      fairPick, quantumTick, fairWake};
+static sched_policy_t stFifoPolicy = {"fifo", fifoEnqueue, fifoDequeue, fifoPick, NULL, NULL};
+static sched_policy_t stRoundRobinPolicy = {"rr", fifoEnqueue, fifoDequeue, fifoPick, quantumTick, NULL};
+
+// ****************************************************************************
+
+void before_ppos_init()
+{
+    char *pcPolicyName = getenv("PPOS_SCHED_POLICY");
+    char *pcTickless = getenv("PPOS_TICKLESS");
+
+    // Deferred preemption relies on the library primitives yielding as they
+    // return only while iPreemptCheck, at offset 0x408, is 0. A rebuilt
+    // library or a moved field would change that without a build error.
+    if (preemptCheckProbe(1) || !preemptCheckProbe(0))
+    {
+        fprintf(stderr, "The core library doesn't read iPreemptCheck at offset 0x%zx of task_t\n",
+                offsetof(task_t, iPreemptCheck));
+        exit(1);
+    }
+
+    bitmapInit(&(stRunQueue.stBitmap));
+    wheelInit();
+
+    sched_register(&stAgingHeapPolicy);
+    sched_register(&stAgingBitmapPolicy);
+    sched_register(&stFairPolicy);
+    sched_register(&stFifoPolicy);
+    sched_register(&stRoundRobinPolicy);
+
+    // The environment wins over a policy set before ppos_init()
+    if ((NULL != pcPolicyName) && (0 > sched_setpolicy(pcPolicyName)))
+    {
+        fprintf(stderr, "Unknown scheduling policy %s, using %s\n", pcPolicyName, SCHED_DEFAULT_POLICY);
+    }
+
+    if (NULL == pstPolicy)
+    {
+        sched_setpolicy(SCHED_DEFAULT_POLICY);
+    }
+
+    cTickless = ((NULL != pcTickless) && (0 != strcmp(pcTickless, "0")));
+
+#ifdef PPOS_RETURN_PREEMPT
+    trampolineInit();
+#endif
+
+    // Interrupt handler initialization, the handlers need the interrupted
+    // context to preempt the task as they return
+    stAction.sa_sigaction = cTickless ? ticklessHandler : tickHandler;
+    sigemptyset(&stAction.sa_mask);
+    stAction.sa_flags = SA_SIGINFO;
+
+    if (sigaction(SIGALRM, &stAction, 0) < 0)
+    {
+        perror("Sigaction error: ");
+        exit(1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stClockStart);
+
+    // In tickless mode the timer is only programmed by the task switches
+    if (cTickless)
+    {
+        systemTime = 0;
+    }
+    else
+    {
+        // Timer initialization, the first tick comes one period from now
+        stTimer.it_value.tv_sec = 0;
+        stTimer.it_value.tv_usec = TIMER_PERIOD_uS;
+        stTimer.it_interval.tv_sec = 0;
+        stTimer.it_interval.tv_usec = TIMER_PERIOD_uS;
+
+        if (setitimer(0, &stTimer, 0) < 0)
+        {
+            perror("Setitimer error: ");
+            exit(1);
+        }
+    }
+
+#ifdef DEBUG
+    printf("\ninit - BEFORE");
+#endif
+}
+
+void after_ppos_init()
+{
+    // put your customization here
+    taskMain->iPreemptCheck = 1;
+    taskMain->iQuantumTicks = DEFAULT_TASK_TICKS;
+    taskMain->uiAvgBurstTicks = 0;
+    taskMain->ucBehavior = PPOS_TASK_CPU_BOUND;
+    taskMain->pstGroup = &stRootGroup;
+    taskMain->ucGroupReady = 0;
+#ifdef DEBUG
+    printf("\ninit - AFTER");
+#endif
+}
+
+void before_task_create(task_t *task)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\ntask_create - BEFORE - [%d]", task->id);
+#endif
+}
+
+void after_task_create(task_t *task)
+{
+    // put your customization here
+    task->uiExecTicks = systemTime;
+    task->iPreemptCheck = 1;
+    task->iQuantumTicks = DEFAULT_TASK_TICKS;
+    task->uiAvgBurstTicks = 0;
+    task->ucBehavior = PPOS_TASK_CPU_BOUND;
+    task->uiDeadlineMisses = 0;
+    task->uiPeriod = 0;
+    task->iBasePrio = task->iStaticPrio;
+    task->pstHeldMutexes = NULL;
+    task->pstBlockedOn = NULL;
+    task->ucGroupReady = 0;
+    task->ucDetached = 0;
+    task->ucSystemTcb = 0;
+    task->stTimerLink.prev = NULL;
+    task->stTimerLink.next = NULL;
+    task->ullAwakeNs = 0;
+    task->pvTimedWait = NULL;
+    task->pfnTimedOut = NULL;
+    task->ucTimedOut = 0;
+    task->uiReadLocks = 0;
+
+    taskReclaim();
+
+    if (NULL != pstCreateAttr)
+    {
+        task->iStaticPrio = pstCreateAttr->prio;
+        task->iDinamPrio = pstCreateAttr->prio;
+        task->iBasePrio = pstCreateAttr->prio;
+        task->ucDetached = pstCreateAttr->detached;
+    }
+
+#ifdef PPOS_STACK_MOVE
+    stackReplace(task, ((NULL != pstCreateAttr) && (0 != pstCreateAttr->stacksize)) ? pstCreateAttr->stacksize
+                                                                                   : STACKSIZE);
+#endif
+
+    // A task belongs to the group of the one that created it
+    task->pstGroup = ((NULL != taskExec) && (NULL != taskExec->pstGroup) && (task != taskDisp))
+                         ? taskExec->pstGroup
+                         : &stRootGroup;
+
+    // The dispatcher is taken out of readyQueue by ppos_init() itself
+    if (task != taskDisp)
+    {
+        // New tasks start at the virtual runtime floor of their group, neither
+        // owing nor being owed processor time
+        task->ullVRuntime = ((ST_RunQueue *)task->pstGroup->pvRunQueue)->ullMinVRuntime;
+        readyEnqueue(task);
+    }
+#ifdef DEBUG
+    printf("\ntask_create - AFTER - [%d]", task->id);
+#endif
+}
+
+void before_task_exit () {
+#ifdef DEBUG
+    printf("\ntask_exit - BEFORE - [%d]", taskExec->id);
+#endif
+}
+
+void after_task_exit()
+{
+    // put your customization here
+
+    // Updates how many ticks the task has taken to be fully executed
+    taskExec->uiExecTicks = (systemTime - taskExec->uiExecTicks);
+
+    // Gives the processor reserved to a real-time task back
+    if (0 != taskExec->uiPeriod)
+    {
+        stRunQueue.ulEdfUtilization -= (taskExec->uiBudget * EDF_MAX_UTILIZATION) / taskExec->uiPeriod;
+        taskExec->uiPeriod = 0;
+    }
+
+    // The task still runs on its stack until the switch to the dispatcher, so
+    // it is only released on the next exit or creation
+    if (taskExec != taskMain)
+    {
+
+        preemptDisable();
+
+        taskReclaim();
+
+#ifdef PPOS_STACK_POOL
+        // The core library frees NULL in place of the pooled stack
+        pvExitedStack = taskExec->context.uc_stack.ss_sp;
+        szExitedStack = taskExec->context.uc_stack.ss_size;
+        taskExec->context.uc_stack.ss_sp = NULL;
+#endif
+
+        if (taskExec->ucSystemTcb)
+        {
+            pstExitedTcb = taskExec;
+        }
+
+        preemptEnable();
+    }
+
+    printTaskInfo();
+
+#ifdef DEBUG
+    printf("\ntask_exit - AFTER- [%d]", taskExec->id);
+#endif
+}
+
+void before_task_switch(task_t *task)
+{
+    // put your customization here
+    task_t *pstPreviousTask = taskExec;
+
+#ifdef PPOS_DIRECT_SWITCH
+    // The rest of the accounting is the one of the dispatcher switching to
+    // the chosen task, if there is one
+    if (cDirectCharged)
+    {
+        cDirectCharged = 0;
+        pstPreviousTask = taskDisp;
+        task = (NULL != pstDirectNext) ? pstDirectNext : task;
+    }
+#endif
+
+    if (cTickless)
+    {
+        ticklessCatchUp();
+        ticklessArm(task);
+    }
+
+    if (pstPreviousTask != task)
+    {
+        metricsHandler(pstPreviousTask, task);
+    }
+
+    // The dispatcher would spin until a task is ready
+    if ((taskDisp == task) && (NULL == readyQueue))
+    {
+        idleArm();
+    }
+#ifdef DEBUG
+    printf("\ntask_switch - BEFORE - [%d -> %d]", taskExec->id, task->id);
+#endif
+}
+
+void after_task_switch(task_t *task)
+{
+    // put your customization here
+
+    // switchInProgress() covers the rest of the switch
+    cYielding = 0;
+
+#ifdef PPOS_DIRECT_SWITCH
+    if (NULL != pstDirectNext)
+    {
+        taskExec = pstDirectNext;
+    }
+#endif
+#ifdef DEBUG
+    printf("\ntask_switch - AFTER - [%d -> %d]", taskExec->id, task->id);
+#endif
+}
+
+void before_task_yield()
+{
+    // put your customization here
+    if (cYieldProbing)
+    {
+        longjmp(stYieldProbe, 1);
+    }
+
+    // The core library doesn't protect task_yield(), the task enters
+    // readyQueue while it still runs
+    cYielding = 1;
+
+    // This call gives the preemption the task owed, if it did
+    if (cReschedPending)
+    {
+        iTaskTicksQty = DEFAULT_TASK_TICKS;
+        cQuantumExpired = !cPreemptPending;
+    }
+
+#ifdef DEBUG
+    printf("\ntask_yield - BEFORE - [%d]", taskExec->id);
+#endif
+}
+void after_task_yield()
+{
+    // put your customization here
+
+    // A suspended task also yields, but it doesn't go back to readyQueue
+    if (TASK_STATE_READY == taskExec->state)
+    {
+        readyEnqueue(taskExec);
+    }
+
+#ifdef PPOS_DIRECT_SWITCH
+    directSwitchPrepare();
+#endif
+#ifdef DEBUG
+    printf("\ntask_yield - AFTER - [%d]", taskExec->id);
+#endif
+}
+
+void before_task_suspend(task_t *task)
+{
+    // put your customization here
+
+    // The core library moves the task between queues unprotected, the
+    // section ends in after_task_suspend()
+    preemptDisable();
+
+    // A sleeping task suspended on another queue no longer waits for its time
+    wheelRemove(task);
+
+#ifdef DEBUG
+    printf("\ntask_suspend - BEFORE - [%d]", task->id);
+#endif
+}
+
+void after_task_suspend(task_t *task)
+{
+    // put your customization here
+    readyDequeue(task);
+
+    // The sleeping tasks wait in the timing wheel, sleepQueue only keeps its
+    // sentinel and the tasks already due
+    if (((task_t *)&sleepQueue == task->queue) && (&stWheelSentinel != task) && (task->awakeTime > systemTime))
+    {
+        queueUnlink(&sleepQueue, task);
+        task->queue = NULL;
+        wheelSchedule(task);
+    }
+
+    preemptEnable();
+#ifdef DEBUG
+    printf("\ntask_suspend - AFTER - [%d]", task->id);
+#endif
+}
+
+void before_task_resume(task_t *task)
+{
+    // put your customization here
+
+    // The section ends in after_task_resume()
+    preemptDisable();
+
+    // A task woken up before its time leaves the timing wheel
+    wheelRemove(task);
+
+#ifdef DEBUG
+    printf("\ntask_resume - BEFORE - [%d]", task->id);
+#endif
+}
+
+void after_task_resume(task_t *task)
+{
+    // put your customization here
+
+    // The sentinel never runs, the dispatcher waking it up drains the wheel
+    if (&stWheelSentinel == task)
+    {
+        queueUnlink(&readyQueue, task);
+        task->queue = NULL;
+        task->state = TASK_STATE_SUSPENDED;
+        sleepShotExpire();
+        wheelExpire(systime());
+
+        if (NULL == readyQueue)
+        {
+            idleWait();
+        }
+
+        preemptEnable();
+        return;
+    }
+
+    if (PPOS_TASK_IO_BOUND == task->ucBehavior)
+    {
+        task->iDinamPrio -= IO_WAKE_BOOST;
+        task->iDinamPrio = (task->iDinamPrio < UNIX_MIN_PRIO) ? UNIX_MIN_PRIO : task->iDinamPrio;
+    }
+
+    if ((0 == task->uiPeriod) && (NULL != pstPolicy->on_wake))
+    {
+        groupSelect(task);
+        pstPolicy->on_wake(task);
+    }
+
+    // A real-time task released by the dispatcher leaves the release heap
+    if ((0 != task->uiPeriod) && (0 != task->iHeapIdx))
+    {
+        readyHeapRemove(&(stRunQueue.stEdfReleases), task);
+    }
+
+    readyEnqueue(task);
+    edfCheckPreempt(task);
+    preemptEnable();
+#ifdef DEBUG
+    printf("\ntask_resume - AFTER - [%d]", task->id);
+#endif
+}
+
+void before_task_sleep()
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\ntask_sleep - BEFORE - [%d]", taskExec->id);
+#endif
+}
+
+void after_task_sleep()
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\ntask_sleep - AFTER - [%d]", taskExec->id);
+#endif
+}
+
+int before_task_join(task_t *task)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\ntask_join - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_task_join(task_t *task)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\ntask_join - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
 
 int before_sem_create(semaphore_t *s, int value)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nsem_create - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    // put your customization here
+#ifdef DEBUG
+    printf("\nsem_create - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_sem_create(semaphore_t *s, int value)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nsem_create - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_sem_down(semaphore_t *s)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nsem_down - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_sem_down(semaphore_t *s)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nsem_down - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_sem_up(semaphore_t *s)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nsem_up - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_sem_up(semaphore_t *s)
+{
+    // put your customization here
+
+    // The core library wakes the tasks waiting in s->queue first, light tasks
+    // only get the units left over, the core library disabled preemption
+    if ((0 < ulLightWaiters) && (0 < s->value))
+    {
+        ltask_t *pstTask = lightWaitTake(s);
+
+        if (NULL != pstTask)
+        {
+            (s->value)--;
+            pstTask->result = 0;
+            lightReady(pstTask, pstTask->func);
+        }
+    }
+#ifdef DEBUG
+    printf("\nsem_up - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_sem_destroy(semaphore_t *s)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nsem_destroy - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_sem_destroy(semaphore_t *s)
+{
+    // put your customization here
+    ltask_t *pstTask = NULL;
+
+    while ((0 < ulLightWaiters) && (NULL != (pstTask = lightWaitTake(s))))
+    {
+        pstTask->result = -1;
+        lightReady(pstTask, pstTask->func);
+    }
+#ifdef DEBUG
+    printf("\nsem_destroy - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mutex_create(mutex_t *m)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nmutex_create - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mutex_create(mutex_t *m)
+{
+    // put your customization here
+    m->pstOwner = NULL;
+    m->pstNextHeld = NULL;
+#ifdef DEBUG
+    printf("\nmutex_create - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mutex_lock(mutex_t *m)
+{
+    // put your customization here
+    // The core library only blocks on a held mutex
+    if ((NULL != m) && m->active && (MUTEX_FREE != m->value))
+    {
+        m->value = MUTEX_HELD;
+        piBoostChain(taskExec, m);
+    }
+#ifdef DEBUG
+    printf("\nmutex_lock - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mutex_lock(mutex_t *m)
+{
+    // put your customization here
+
+    // The core library also calls this hook right before blocking, a waiter
+    // only becomes the owner when mutex_unlock() hands the mutex over
+    if ((NULL != m) && m->active && (TASK_STATE_SUSPENDED != taskExec->state))
+    {
+        mutexOwn(taskExec, m);
+    }
+    else if ((NULL != m) && m->active)
+    {
+        m->value = MUTEX_CONTENDED;
+    }
+#ifdef DEBUG
+    printf("\nmutex_lock - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mutex_unlock(mutex_t *m)
+{
+    // put your customization here
+    task_t *pstOwner = NULL;
+    task_t *pstWaiter = NULL;
+    task_t *pstBest = NULL;
+
+    if ((NULL == m) || !m->active)
+    {
+        return 0;
+    }
+
+    // The core library hands a held mutex over to its first waiter
+    if (MUTEX_CONTENDED == m->value)
+    {
+        m->value = MUTEX_HELD;
+    }
+
+    if (NULL == m->pstOwner)
+    {
+        return 0;
+    }
+
+    pstOwner = m->pstOwner;
+    piHeldRemove(pstOwner, m);
+    m->pstOwner = NULL;
+
+    // The mutex is handed to the head of its queue, so the most urgent waiter
+    // is moved there, the others keep their arrival order
+    if (NULL != m->queue)
+    {
+        pstBest = m->queue;
+        pstWaiter = m->queue->next;
+
+        while (pstWaiter != m->queue)
+        {
+            pstBest = (pstWaiter->iStaticPrio < pstBest->iStaticPrio) ? pstWaiter : pstBest;
+            pstWaiter = pstWaiter->next;
+        }
+
+        if (pstBest != m->queue)
+        {
+            queue_remove((queue_t **)&(m->queue), (queue_t *)pstBest);
+            queue_append((queue_t **)&(m->queue), (queue_t *)pstBest);
+            m->queue = pstBest;
+        }
+
+        mutexOwn(pstBest, m);
+        pstBest->pstBlockedOn = NULL;
+        piSetPrio(pstBest, piEffectivePrio(pstBest));
+    }
+
+    piSetPrio(pstOwner, piEffectivePrio(pstOwner));
+#ifdef DEBUG
+    printf("\nmutex_unlock - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mutex_unlock(mutex_t *m)
+{
+    // put your customization here
+
+    // The new owner still has tasks waiting behind it
+    if ((NULL != m) && m->active && (NULL != m->queue))
+    {
+        m->value = MUTEX_CONTENDED;
+    }
+#ifdef DEBUG
+    printf("\nmutex_unlock - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mutex_destroy(mutex_t *m)
+{
+    // put your customization here
+    task_t *pstWaiter = NULL;
+
+    if ((NULL == m) || !m->active)
+    {
+        return 0;
+    }
+
+    if (NULL != m->pstOwner)
+    {
+        piHeldRemove(m->pstOwner, m);
+        piSetPrio(m->pstOwner, piEffectivePrio(m->pstOwner));
+        m->pstOwner = NULL;
+    }
+
+    // The waiters are released without the mutex
+    if (NULL != m->queue)
+    {
+        pstWaiter = m->queue;
+
+        do
+        {
+            pstWaiter->pstBlockedOn = NULL;
+            pstWaiter = pstWaiter->next;
+        } while (pstWaiter != m->queue);
+    }
+#ifdef DEBUG
+    printf("\nmutex_destroy - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mutex_destroy(mutex_t *m)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nmutex_destroy - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_barrier_create(barrier_t *b, int N)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nbarrier_create - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_barrier_create(barrier_t *b, int N)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nbarrier_create - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_barrier_join(barrier_t *b)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nbarrier_join - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_barrier_join(barrier_t *b)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nbarrier_join - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_barrier_destroy(barrier_t *b)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nbarrier_destroy - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_barrier_destroy(barrier_t *b)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nbarrier_destroy - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mqueue_create(mqueue_t *queue, int max, int size)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nmqueue_create - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mqueue_create(mqueue_t *queue, int max, int size)
+{
+    // put your customization here
+    queue->layout = MQUEUE_LAYOUT_NONE;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->sender = NULL;
+    queue->receiver = NULL;
+    sem_create(&(queue->sRingItem), 0);
+    sem_create(&(queue->sRingVaga), max);
+    sem_create(&(queue->sSend), 1);
+    sem_create(&(queue->sRecv), 1);
+#ifdef DEBUG
+    printf("\nmqueue_create - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mqueue_send(mqueue_t *queue, void *msg)
+{
+    // put your customization here
+    // The return value is ignored: on a ring the library finds sItem and sVaga
+    // destroyed and fails by itself
+    mqueueLayout(queue, MQUEUE_LAYOUT_LINEAR);
+#ifdef DEBUG
+    printf("\nmqueue_send - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mqueue_send(mqueue_t *queue, void *msg)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nmqueue_send - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mqueue_recv(mqueue_t *queue, void *msg)
+{
+    // put your customization here
+    // The return value is ignored: on a ring the library finds sItem and sVaga
+    // destroyed and fails by itself
+    mqueueLayout(queue, MQUEUE_LAYOUT_LINEAR);
+#ifdef DEBUG
+    printf("\nmqueue_recv - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mqueue_recv(mqueue_t *queue, void *msg)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nmqueue_recv - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mqueue_destroy(mqueue_t *queue)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nmqueue_destroy - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mqueue_destroy(mqueue_t *queue)
+{
+    // put your customization here
+    sem_destroy(&(queue->sRingItem));
+    sem_destroy(&(queue->sRingVaga));
+    sem_destroy(&(queue->sSend));
+    sem_destroy(&(queue->sRecv));
+#ifdef DEBUG
+    printf("\nmqueue_destroy - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int before_mqueue_msgs(mqueue_t *queue)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nmqueue_msgs - BEFORE - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+int after_mqueue_msgs(mqueue_t *queue)
+{
+    // put your customization here
+#ifdef DEBUG
+    printf("\nmqueue_msgs - AFTER - [%d]", taskExec->id);
+#endif
+    return 0;
+}
+
+void task_attr_init(task_attr_t *attr)
+{
+    if (NULL != attr)
+    {
+        attr->stacksize = STACKSIZE;
+        attr->prio = 0;
+        attr->detached = 0;
+    }
+
+    return;
+}
+
+int task_create_ex(task_t *task, const task_attr_t *attr, void (*start_func)(void *), void *arg)
+{
+    char cSystemTcb = 0;
+    int iId = 0;
+
+    if ((NULL != attr) && ((UNIX_MIN_PRIO > attr->prio) || (UNIX_MAX_PRIO < attr->prio)))
+    {
+        return -1;
+    }
+
+    // Only a detached task may have its task_t allocated here, nobody else
+    // would know when to free it
+    if (NULL == task)
+    {
+        if ((NULL == attr) || !attr->detached)
+        {
+            return -1;
+        }
+
+        // calloc() only aligns to 16 bytes, the hot fields need the task_t
+        // aligned to a cache line
+        if (0 != posix_memalign((void **)&task, _Alignof(task_t), sizeof(task_t)))
+        {
+            return -1;
+        }
+
+        memset(task, 0, sizeof(task_t));
+
+        cSystemTcb = 1;
+    }
+
+    preemptDisable();
+
+    pstCreateAttr = attr;
+    iId = task_create(task, start_func, arg);
+    pstCreateAttr = NULL;
+
+    if (0 <= iId)
+    {
+        task->ucSystemTcb = cSystemTcb;
+    }
+    else if (cSystemTcb)
+    {
+        free(task);
+    }
+
+    preemptEnable();
+    preemptPoint();
+
+    return iId;
+}
+
+void task_setprio(task_t *task, int prio)
+{
+    char cIsReady = 0;
+
+    if ((UNIX_MIN_PRIO <= prio) && (UNIX_MAX_PRIO >= prio))
+    {
+        if (NULL == task)
+        {
+            task = taskExec;
+        }
+
+        preemptDisable();
+
+        // The policy files a ready task by its priority, so it leaves the
+        // ready structures before the change and comes back after it
+        cIsReady = ((task != taskExec) && (TASK_STATE_READY == task->state));
+
+        if (cIsReady)
+        {
+            readyDequeue(task);
+        }
+
+        // A priority inherited from a mutex waiter stays until the unlock
+        task->iBasePrio = prio;
+        task->iStaticPrio = piEffectivePrio(task);
+
+        if (cIsReady)
+        {
+            readyEnqueue(task);
+        }
+
+        preemptEnable();
+    }
+
+    return;
+}
+
+int task_getprio(task_t *task)
+{
+    int iPrio = 0;
+
+    if (NULL != task)
+    {
+        iPrio = task->iBasePrio;
+    }
+    else
+    {
+        iPrio = taskExec->iBasePrio;
+    }
+
+    return iPrio;
+}
+
+int sched_register(sched_policy_t *policy)
+{
+    if ((NULL == policy) || (NULL == policy->name) || (NULL == policy->pick_next) ||
+        (NULL != schedFind(policy->name)) || (SCHED_MAX_POLICIES <= iPoliciesQty))
+    {
+        return -1;
+    }
+
+    apstPolicies[iPoliciesQty] = policy;
+    iPoliciesQty++;
+
+    return 0;
+}
+
+int sched_setpolicy(const char *name)
+{
+    sched_policy_t *pstNewPolicy = schedFind(name);
+    task_t *pstTask = readyQueue;
+
+    if (NULL == pstNewPolicy)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    // The ready tasks move from the structures of the old policy to the new one
+    if (NULL != pstTask)
+    {
+        do
+        {
+            // Real-time tasks stay in the deadline heap
+            if (0 != pstTask->uiPeriod)
+            {
+                pstTask = pstTask->next;
+                continue;
+            }
+
+            groupSelect(pstTask);
+
+            if ((NULL != pstPolicy) && (NULL != pstPolicy->dequeue))
+            {
+                pstPolicy->dequeue(pstTask);
+            }
+
+            if (NULL != pstNewPolicy->enqueue)
+            {
+                pstNewPolicy->enqueue(pstTask);
+            }
+
+            pstTask = pstTask->next;
+        } while (pstTask != readyQueue);
+    }
+
+    pstPolicy = pstNewPolicy;
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+const char *sched_getpolicy()
+{
+    return (NULL != pstPolicy) ? pstPolicy->name : NULL;
+}
+
+int task_set_deadline(task_t *task, unsigned int period, unsigned int budget)
+{
+    unsigned long ulOldShare = 0;
+    unsigned long ulNewShare = 0;
+    char cIsReady = 0;
+
+    task = (NULL != task) ? task : taskExec;
+
+    if ((0 != period) && ((0 == budget) || (budget > period)))
+    {
+        return -1;
+    }
+
+    ulOldShare = (0 != task->uiPeriod) ? ((task->uiBudget * EDF_MAX_UTILIZATION) / task->uiPeriod) : 0;
+    ulNewShare = (0 != period) ? ((budget * EDF_MAX_UTILIZATION) / period) : 0;
+
+    // Admission test: EDF meets every deadline while the utilization is <= 1
+    if ((stRunQueue.ulEdfUtilization - ulOldShare + ulNewShare) > EDF_MAX_UTILIZATION)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    // A ready task moves to the structures of its new class
+    cIsReady = ((task != taskExec) && (TASK_STATE_READY == task->state));
+
+    if (cIsReady)
+    {
+        readyDequeue(task);
+    }
+
+    stRunQueue.ulEdfUtilization = stRunQueue.ulEdfUtilization - ulOldShare + ulNewShare;
+
+    if (cTickless)
+    {
+        ticklessClockUpdate();
+    }
+
+    task->uiPeriod = period;
+    task->uiBudget = budget;
+    task->uiDeadline = systemTime + period;
+    task->uiBudgetUsed = 0;
+
+    if (cIsReady)
+    {
+        readyEnqueue(task);
+        edfCheckPreempt(task);
+    }
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+void task_wait_period()
+{
+    task_t *pstTask = taskExec;
+    unsigned int uiRelease = 0;
+
+    if (0 == pstTask->uiPeriod)
+    {
+        task_yield();
+        return;
+    }
+
+    preemptDisable();
+
+    if (cTickless)
+    {
+        ticklessClockUpdate();
+    }
+
+    if (systemTime > pstTask->uiDeadline)
+    {
+        (pstTask->uiDeadlineMisses)++;
+    }
+
+    // The next job is released at the deadline of this one
+    uiRelease = pstTask->uiDeadline;
+    pstTask->uiDeadline = uiRelease + pstTask->uiPeriod;
+    pstTask->uiBudgetUsed = 0;
+
+    preemptEnable();
+
+    // A late job has its next one released already, it only goes back to
+    // the deadline heap with the new deadline
+    if (uiRelease > systemTime)
+    {
+        pstTask->awakeTime = uiRelease;
+        task_suspend(NULL, &sleepQueue);
+        readyHeapInsert(&(stRunQueue.stEdfReleases), pstTask, (long long)uiRelease);
+    }
+
+    task_yield();
+
+    return;
+}
+
+unsigned long long systime_ns()
+{
+    struct timespec stNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &stNow);
+
+    return ((unsigned long long)(stNow.tv_sec - stClockStart.tv_sec) * 1000000000ULL) +
+           (unsigned long long)(stNow.tv_nsec - stClockStart.tv_nsec);
+}
+
+unsigned long long systime_idle_ns()
+{
+    return ullIdleNs;
+}
+
+void task_sleep_us(unsigned long long us)
+{
+    task_sleep_until(systime_ns() + (us * CLOCK_NS_PER_US));
+
+    return;
+}
+
+void task_sleep_until(unsigned long long ns)
+{
+    unsigned int uiTick = 0;
+
+    // The timing wheel takes the whole ticks but the last one. The rest of
+    // the wait ends at that last tick or, with the periodic timer, at a shot
+    // programmed for the deadline. A tick that came some microseconds early
+    // only starts another sleep.
+    while (systime_ns() < ns)
+    {
+        preemptDisable();
+
+        uiTick = deadlineTick(ns);
+
+        if (!cTickless && (0 != ullFirstTickNs) && (1 < (uiTick - systemTime)))
+        {
+            taskExec->awakeTime = uiTick - 1;
+            taskExec->ullAwakeNs = 0;
+        }
+        else
+        {
+            taskExec->awakeTime = uiTick;
+            taskExec->ullAwakeNs = ns;
+            sleepShotArm(ns);
+        }
+
+        preemptEnable();
+
+        task_suspend(NULL, &sleepQueue);
+        task_yield();
+    }
+
+    taskExec->ullAwakeNs = 0;
+
+    return;
+}
+
+int task_join_timed(task_t *task, unsigned long long deadline)
+{
+    unsigned int uiTick = 0;
+
+    if (NULL == task)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    if (TASK_STATE_TERMINATED == task->state)
+    {
+        preemptEnable();
+        preemptPoint();
+        return task->exitCode;
+    }
+
+    uiTick = deadlineTick(deadline);
+
+    if (systemTime == uiTick)
+    {
+        preemptEnable();
+        preemptPoint();
+        return PPOS_ETIMEDOUT;
+    }
+
+    if (timedWait(&(task->joinQueue), deadline, uiTick, task, NULL))
+    {
+        return PPOS_ETIMEDOUT;
+    }
+
+    return task->exitCode;
+}
+
+int sem_down_timed(semaphore_t *s, unsigned long long deadline)
+{
+    unsigned int uiTick = 0;
+
+    if ((NULL == s) || !s->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    // A free unit is taken by sem_down() itself, which doesn't block
+    if (0 < s->value)
+    {
+        sem_down(s);
+        preemptEnable();
+        preemptPoint();
+        return 0;
+    }
+
+    uiTick = deadlineTick(deadline);
+
+    if (systemTime == uiTick)
+    {
+        preemptEnable();
+        preemptPoint();
+        return PPOS_ETIMEDOUT;
+    }
+
+    // The same steps sem_down() takes to block the running task
+    (s->value)--;
+
+    if (timedWait(&(s->queue), deadline, uiTick, s, semTimedOut))
+    {
+        return PPOS_ETIMEDOUT;
+    }
+
+    return s->active ? 0 : -1;
+}
+
+int mutex_lock_timed(mutex_t *m, unsigned long long deadline)
+{
+    unsigned int uiTick = 0;
+
+    if ((NULL == m) || !m->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    if (MUTEX_FREE == m->value)
+    {
+        mutex_lock(m);
+        preemptEnable();
+        preemptPoint();
+        return 0;
+    }
+
+    uiTick = deadlineTick(deadline);
+
+    if (systemTime == uiTick)
+    {
+        preemptEnable();
+        preemptPoint();
+        return PPOS_ETIMEDOUT;
+    }
+
+    // The waiter lends its priority to the owner, as in mutex_lock(), and
+    // mutex_unlock() hands the mutex over to it
+    m->value = MUTEX_CONTENDED;
+    piBoostChain(taskExec, m);
+
+    if (timedWait(&(m->queue), deadline, uiTick, m, mutexTimedOut))
+    {
+        return PPOS_ETIMEDOUT;
+    }
+
+    return m->active ? 0 : -1;
+}
+
+int barrier_join_timed(barrier_t *b, unsigned long long deadline)
+{
+    unsigned int uiTick = 0;
+    int iResult = 0;
+
+    if ((NULL == b) || !b->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    // The last task to arrive releases the others, barrier_join() doesn't
+    // block it
+    if ((b->countTasks + 1) == b->maxTasks)
+    {
+        iResult = barrier_join(b);
+        preemptEnable();
+        preemptPoint();
+        return iResult;
+    }
+
+    uiTick = deadlineTick(deadline);
+
+    if (systemTime == uiTick)
+    {
+        preemptEnable();
+        preemptPoint();
+        return PPOS_ETIMEDOUT;
+    }
+
+    (b->countTasks)++;
+
+    if (timedWait(&(b->queue), deadline, uiTick, b, barrierTimedOut))
+    {
+        return PPOS_ETIMEDOUT;
+    }
+
+    return b->active ? 0 : -1;
+}
+
+int mqueue_send_timed(mqueue_t *queue, void *msg, unsigned long long deadline)
+{
+    int iResult = 0;
+
+    if ((NULL == queue) || !queue->active || (NULL == msg) || (0 > mqueueLayout(queue, MQUEUE_LAYOUT_LINEAR)))
+    {
+        return -1;
+    }
+
+    // The same steps as mqueue_send(), only the wait for a free slot has a
+    // deadline, the buffer is only held for a copy
+    iResult = sem_down_timed(&(queue->sVaga), deadline);
+
+    if (0 != iResult)
+    {
+        return iResult;
+    }
+
+    if (0 > sem_down(&(queue->sBuffer)))
+    {
+        return -1;
+    }
+
+    memcpy((char *)queue->content + (queue->countMessages * queue->messageSize), msg, queue->messageSize);
+    (queue->countMessages)++;
+
+    sem_up(&(queue->sBuffer));
+    sem_up(&(queue->sItem));
+
+    return 0;
+}
+
+int mqueue_recv_timed(mqueue_t *queue, void *msg, unsigned long long deadline)
+{
+    int iResult = 0;
+
+    if ((NULL == queue) || !queue->active || (NULL == msg) || (0 > mqueueLayout(queue, MQUEUE_LAYOUT_LINEAR)))
+    {
+        return -1;
+    }
+
+    // The same steps as mqueue_recv(), only the wait for a message has a
+    // deadline
+    iResult = sem_down_timed(&(queue->sItem), deadline);
+
+    if (0 != iResult)
+    {
+        return iResult;
+    }
+
+    if (0 > sem_down(&(queue->sBuffer)))
+    {
+        return -1;
+    }
+
+    (queue->countMessages)--;
+    memcpy(msg, queue->content, queue->messageSize);
+    memmove(queue->content, (char *)queue->content + queue->messageSize,
+            queue->countMessages * queue->messageSize);
+
+    sem_up(&(queue->sBuffer));
+    sem_up(&(queue->sVaga));
+
+    return 0;
+}
+
+void *mqueue_reserve(mqueue_t *queue)
+{
+    if ((NULL == queue) || !queue->active || (0 > mqueueLayout(queue, MQUEUE_LAYOUT_RING)))
+    {
+        return NULL;
+    }
+
+    // A free slot, then the send side: the slot after the last message is
+    // the sender's until it commits
+    if (0 > sem_down_fast(&(queue->sRingVaga)))
+    {
+        return NULL;
+    }
+
+    if (0 > sem_down_fast(&(queue->sSend)))
+    {
+        sem_up_fast(&(queue->sRingVaga));
+        return NULL;
+    }
+
+    queue->sender = taskExec;
+
+    return (char *)queue->content + (queue->tail * queue->messageSize);
+}
+
+int mqueue_commit(mqueue_t *queue)
+{
+    if ((NULL == queue) || !queue->active || (taskExec != queue->sender))
+    {
+        return -1;
+    }
+
+    mqueueCommit(queue);
+    preemptPoint();
+
+    return 0;
+}
+
+void *mqueue_peek(mqueue_t *queue)
+{
+    if ((NULL == queue) || !queue->active || (0 > mqueueLayout(queue, MQUEUE_LAYOUT_RING)))
+    {
+        return NULL;
+    }
+
+    // A message, then the receive side: the oldest message stays in its slot
+    // until the receiver releases it
+    if (0 > sem_down_fast(&(queue->sRingItem)))
+    {
+        return NULL;
+    }
+
+    if (0 > sem_down_fast(&(queue->sRecv)))
+    {
+        sem_up_fast(&(queue->sRingItem));
+        return NULL;
+    }
+
+    queue->receiver = taskExec;
+
+    return (char *)queue->content + (queue->head * queue->messageSize);
+}
+
+int mqueue_release(mqueue_t *queue)
+{
+    if ((NULL == queue) || !queue->active || (taskExec != queue->receiver))
+    {
+        return -1;
+    }
+
+    mqueueRelease(queue);
+    preemptPoint();
+
+    return 0;
+}
+
+int mqueue_send_ring(mqueue_t *queue, void *msg)
+{
+    void *pvSlot = NULL;
+
+    if (NULL == msg)
+    {
+        return -1;
+    }
+
+    pvSlot = mqueue_reserve(queue);
+
+    if (NULL == pvSlot)
+    {
+        return -1;
+    }
+
+    memcpy(pvSlot, msg, queue->messageSize);
+
+    return mqueue_commit(queue);
+}
+
+int mqueue_recv_ring(mqueue_t *queue, void *msg)
+{
+    void *pvSlot = NULL;
+
+    if (NULL == msg)
+    {
+        return -1;
+    }
+
+    pvSlot = mqueue_peek(queue);
+
+    if (NULL == pvSlot)
+    {
+        return -1;
+    }
+
+    memcpy(msg, pvSlot, queue->messageSize);
+
+    return mqueue_release(queue);
+}
+
+int sem_down_fast(semaphore_t *s)
+{
+    int iValue = 0;
+
+    // A positive value means nobody is waiting, so a unit is taken by the
+    // swap alone; a signal handler changing it in between makes it fail.
+    // The library call would have been a safe point for a deferred
+    // preemption, and so is its fast path.
+    if ((NULL != s) && s->active)
+    {
+        while (0 < (iValue = s->value))
+        {
+            if (casInt(&(s->value), iValue, iValue - 1))
+            {
+                preemptPoint();
+                return 0;
+            }
+        }
+    }
+
+    return sem_down(s);
+}
+
+int sem_up_fast(semaphore_t *s)
+{
+    int iValue = 0;
+
+    // A negative value counts the tasks waiting, one of them is woken up by
+    // the core library
+    if ((NULL != s) && s->active)
+    {
+        while (0 <= (iValue = s->value))
+        {
+            if (casInt(&(s->value), iValue, iValue + 1))
+            {
+                // Light tasks wait without counting, the unit may be theirs
+                if (0 < ulLightWaiters)
+                {
+                    preemptDisable();
+                    after_sem_up(s);
+                    preemptEnable();
+                }
+
+                preemptPoint();
+                return 0;
+            }
+        }
+    }
+
+    return sem_up(s);
+}
+
+int mutex_lock_fast(mutex_t *m)
+{
+    if ((NULL == m) || !m->active || !casUChar(&(m->value), MUTEX_FREE, MUTEX_HELD))
+    {
+        return mutex_lock(m);
+    }
+
+    mutexOwn(taskExec, m);
+
+    // A task that blocked before the owner was recorded could not lend it its
+    // priority
+    if (MUTEX_CONTENDED == m->value)
+    {
+        piSetPrio(taskExec, piEffectivePrio(taskExec));
+    }
+
+    preemptPoint();
+
+    return 0;
+}
+
+int mutex_unlock_fast(mutex_t *m)
+{
+    if ((NULL == m) || !m->active || (taskExec != m->pstOwner))
+    {
+        return mutex_unlock(m);
+    }
+
+    // The owner is cleared first, a task taking the mutex right after the
+    // swap records itself. Mutexes are mostly released in the reverse order
+    // they were taken in, the last one taken heads the list.
+    if (m == taskExec->pstHeldMutexes)
+    {
+        taskExec->pstHeldMutexes = m->pstNextHeld;
+        m->pstNextHeld = NULL;
+    }
+    else
+    {
+        piHeldRemove(taskExec, m);
+    }
+
+    m->pstOwner = NULL;
+
+    if (casUChar(&(m->value), MUTEX_HELD, MUTEX_FREE))
+    {
+        preemptPoint();
+        return 0;
+    }
+
+    // Tasks are waiting, nobody else can take it, the core library hands it
+    // over to one of them
+    mutexOwn(taskExec, m);
+
+    return mutex_unlock(m);
+}
+
+int cond_create(cond_t *cond)
+{
+    if (NULL == cond)
+    {
+        return -1;
+    }
+
+    cond->queue = NULL;
+    cond->mutex = NULL;
+    cond->active = 1;
+
+    return 0;
+}
+
+int cond_wait(cond_t *cond, mutex_t *m)
+{
+    if ((NULL == cond) || !cond->active || (NULL == m) || !m->active)
+    {
+        return -1;
+    }
+
+    // The mutex is released and the task blocked in the same section, no
+    // signal can come in between
+    preemptDisable();
+
+    cond->mutex = m;
+    mutex_unlock_fast(m);
+    task_suspend(taskExec, &(cond->queue));
+
+    preemptEnable();
+    task_yield();
+
+    // Unless the wake up has already handed the mutex over
+    if (m->pstOwner != taskExec)
+    {
+        mutex_lock_fast(m);
+    }
+
+    return cond->active ? 0 : -1;
+}
+
+int cond_signal(cond_t *cond)
+{
+    if ((NULL == cond) || !cond->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    if (NULL != cond->queue)
+    {
+        condRequeue(cond->queue, cond->mutex, 0);
+    }
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int cond_broadcast(cond_t *cond)
+{
+    if ((NULL == cond) || !cond->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    while (NULL != cond->queue)
+    {
+        condRequeue(cond->queue, cond->mutex, 1);
+    }
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int cond_destroy(cond_t *cond)
+{
+    if ((NULL == cond) || !cond->active)
+    {
+        return -1;
+    }
+
+    // The waiters still get the mutex back, cond_wait() tells them it failed
+    preemptDisable();
+
+    cond->active = 0;
+
+    while (NULL != cond->queue)
+    {
+        condRequeue(cond->queue, cond->mutex, 1);
+    }
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int rwlock_create(rwlock_t *rw, int mode)
+{
+    if ((NULL == rw) || ((PPOS_RWLOCK_PREFER_WRITER != mode) && (PPOS_RWLOCK_PREFER_READER != mode)))
+    {
+        return -1;
+    }
+
+    rw->readQueue = NULL;
+    rw->writeQueue = NULL;
+    rw->writer = NULL;
+    rw->countReaders = 0;
+    rw->countBypass = 0;
+    rw->mode = (unsigned char)mode;
+    rw->active = 1;
+
+    return 0;
+}
+
+int rwlock_rdlock(rwlock_t *rw)
+{
+    if ((NULL == rw) || !rw->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    // A reader joins the ones reading unless a writer is waiting; preferring
+    // the readers, only a few of them pass it
+    if ((NULL == rw->writer) &&
+        ((NULL == rw->writeQueue) || ((PPOS_RWLOCK_PREFER_READER == rw->mode) && (0 < rw->countReaders) &&
+                                      (PPOS_RWLOCK_READER_BYPASS > rw->countBypass))))
+    {
+        rw->countBypass += (NULL != rw->writeQueue);
+        (rw->countReaders)++;
+        (taskExec->uiReadLocks)++;
+        preemptEnable();
+        preemptPoint();
+        return 0;
+    }
+
+    return rwlockWait(rw, &(rw->readQueue));
+}
+
+int rwlock_wrlock(rwlock_t *rw)
+{
+    if ((NULL == rw) || !rw->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    if ((NULL == rw->writer) && (0 == rw->countReaders))
+    {
+        rw->writer = taskExec;
+        rw->countBypass = 0;
+        preemptEnable();
+        preemptPoint();
+        return 0;
+    }
+
+    return rwlockWait(rw, &(rw->writeQueue));
+}
+
+int rwlock_unlock(rwlock_t *rw)
+{
+    if ((NULL == rw) || !rw->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    if (taskExec == rw->writer)
+    {
+        rw->writer = NULL;
+        rwlockGrant(rw, 1);
+    }
+    else if ((0 < rw->countReaders) && (0 < taskExec->uiReadLocks))
+    {
+        // A task holding no read lock can't let a writer in on the readers
+        (rw->countReaders)--;
+        (taskExec->uiReadLocks)--;
+        assert(0 <= rw->countReaders);
+        rwlockGrant(rw, 0);
+    }
+    else
+    {
+        preemptEnable();
+        return -1;
+    }
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int rwlock_destroy(rwlock_t *rw)
+{
+    if ((NULL == rw) || !rw->active)
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    rw->active = 0;
+
+    while (NULL != rw->readQueue)
+    {
+        task_resume(rw->readQueue);
+    }
+
+    while (NULL != rw->writeQueue)
+    {
+        task_resume(rw->writeQueue);
+    }
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int task_group_create(task_group_t *group, unsigned int shares)
+{
+    ST_RunQueue *pstRunQueue = NULL;
+
+    if (NULL == group)
+    {
+        return -1;
+    }
+
+    pstRunQueue = (ST_RunQueue *)calloc(1, sizeof(ST_RunQueue));
+
+    if (NULL == pstRunQueue)
+    {
+        return -1;
+    }
+
+    bitmapInit(&(pstRunQueue->stBitmap));
+
+    group->shares = (0 != shares) ? shares : GROUP_DEFAULT_SHARES;
+    group->quota = 0;
+    group->period = 0;
+    group->usage = 0;
+    group->uiQuotaUsed = 0;
+    group->uiPeriodStart = 0;
+    group->uiReadyTasks = 0;
+    group->ullVRuntime = ullMinGroupVRuntime;
+    group->pvRunQueue = pstRunQueue;
+
+    preemptDisable();
+
+    group->pstNext = stRootGroup.pstNext;
+    stRootGroup.pstNext = group;
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int task_group_attach(task_group_t *group, task_t *task)
+{
+    char cIsReady = 0;
+
+    group = (NULL != group) ? group : &stRootGroup;
+    task = (NULL != task) ? task : taskExec;
+
+    if ((NULL == group->pvRunQueue) || (task == taskDisp))
+    {
+        return -1;
+    }
+
+    if (group == task->pstGroup)
+    {
+        return 0;
+    }
+
+    preemptDisable();
+
+    cIsReady = ((task != taskExec) && (TASK_STATE_READY == task->state));
+
+    if (cIsReady)
+    {
+        readyDequeue(task);
+    }
+
+    // The virtual runtime of the old group means nothing in the new one
+    task->pstGroup = group;
+    task->ullVRuntime = ((ST_RunQueue *)group->pvRunQueue)->ullMinVRuntime;
+
+    if (cIsReady)
+    {
+        readyEnqueue(task);
+    }
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int task_group_set_quota(task_group_t *group, unsigned int quota, unsigned int period)
+{
+
+    if ((NULL == group) || (NULL == group->pvRunQueue) ||
+        ((0 != quota) && ((0 == period) || (quota > period))))
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    if (cTickless)
+    {
+        ticklessClockUpdate();
+    }
+
+    group->quota = quota;
+    group->period = period;
+    group->uiQuotaUsed = 0;
+    group->uiPeriodStart = systemTime;
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int ltask_create(ltask_t *task, void (*func)(ltask_t *, void *), void *arg)
+{
+    task_attr_t stAttr;
+
+    if ((NULL == task) || (NULL == func))
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    // The system task the light tasks run on exits when they are over, so it
+    // is created again by the first light task after that
+    if (NULL == pstLightRunner)
+    {
+        task_attr_init(&stAttr);
+        stAttr.detached = 1;
+
+        if (0 > task_create_ex(NULL, &stAttr, lightRunnerBody, NULL))
+        {
+            preemptEnable();
+            return -1;
+        }
+
+        // task_create() appended the new task_t to the tail of readyQueue
+        pstLightRunner = readyQueue->prev;
+    }
+
+    ulLightTasks++;
+    task->arg = arg;
+    task->result = 0;
+    task->pstWaitSem = NULL;
+    task->pstMqueue = NULL;
+    lightReady(task, func);
+
+    preemptEnable();
+    preemptPoint();
+
+    return 0;
+}
+
+int ltask_yield(ltask_t *task, void (*func)(ltask_t *, void *))
+{
+
+    if ((NULL == func) || !lightMayContinue(task))
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    cLightContinued = 1;
+    lightReady(task, func);
+
+    preemptEnable();
+
+    return 0;
+}
+
+int ltask_sem_down(ltask_t *task, semaphore_t *s, void (*func)(ltask_t *, void *))
+{
+
+    if ((NULL == s) || !s->active || (NULL == func) || !lightMayContinue(task))
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    cLightContinued = 1;
+
+    // Even when the unit is taken right away the continuation runs from the
+    // ready FIFO, so a light task looping on a semaphore doesn't nest calls
+    if (lightSemWait(task, s, func))
+    {
+        lightReady(task, func);
+    }
+
+    preemptEnable();
+
+    return 0;
+}
+
+int ltask_mqueue_send(ltask_t *task, mqueue_t *queue, void *msg, void (*func)(ltask_t *, void *))
+{
+
+    if ((NULL == queue) || !queue->active || (NULL == msg) || (NULL == func) || !lightMayContinue(task) ||
+        (0 > mqueueLayout(queue, MQUEUE_LAYOUT_LINEAR)))
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    cLightContinued = 1;
+    task->pstMqueue = queue;
+    task->pvMsg = msg;
+    task->pfnDone = func;
+
+    // The same steps as mqueue_send(): a free slot, then the buffer
+    if (lightSemWait(task, &(queue->sVaga), lightSendSlot))
+    {
+        lightSendSlot(task, task->arg);
+    }
+
+    preemptEnable();
+
+    return 0;
+}
+
+int ltask_mqueue_recv(ltask_t *task, mqueue_t *queue, void *msg, void (*func)(ltask_t *, void *))
+{
+
+    if ((NULL == queue) || !queue->active || (NULL == msg) || (NULL == func) || !lightMayContinue(task) ||
+        (0 > mqueueLayout(queue, MQUEUE_LAYOUT_LINEAR)))
+    {
+        return -1;
+    }
+
+    preemptDisable();
+
+    cLightContinued = 1;
+    task->pstMqueue = queue;
+    task->pvMsg = msg;
+    task->pfnDone = func;
+
+    // The same steps as mqueue_recv(): a message, then the buffer
+    if (lightSemWait(task, &(queue->sItem), lightRecvItem))
+    {
+        lightRecvItem(task, task->arg);
+    }
+
+    preemptEnable();
+
+    return 0;
+}
+
+task_t *scheduler()
+{
+    task_t *pstNextTask = edfPick();
+    char cThrottled = 0;
+
+    // Real-time tasks always run before the normal ones
+    if ((NULL == pstNextTask) && schedGroupAware())
+    {
+        pstNextTask = groupPick(&cThrottled);
+    }
+    else if (NULL == pstNextTask)
+    {
+        pstNextTask = pstPolicy->pick_next();
+    }
+
+    // While the only ready tasks are the ones of throttled groups the
+    // dispatcher waits, the quota refill is checked on each call
+    if ((NULL == pstNextTask) && !cThrottled)
+    {
+        pstNextTask = readyQueue;
+    }
+
+    if ((NULL != pstNextTask) && pstNextTask->ucGroupReady)
+    {
+        pstNextTask->ucGroupReady = 0;
+        (pstNextTask->pstGroup->uiReadyTasks)--;
+    }
+
+    return pstNextTask;
+}
+
+#ifdef PPOS_NATIVE_SWITCH
+_Static_assert(offsetof(ucontext_t, uc_mcontext.gregs) == UCTX_R8, "ucontext_t layout");
+_Static_assert(offsetof(ucontext_t, uc_mcontext.fpregs) == UCTX_FPREGS, "ucontext_t layout");
+_Static_assert(offsetof(ucontext_t, __fpregs_mem) == UCTX_FPREGS_MEM, "ucontext_t layout");
+_Static_assert(offsetof(task_t, context) == TASK_CONTEXT, "task_t layout");
+
+#ifdef PPOS_DIRECT_SWITCH
+#define SWITCH_REDIRECT                                                                                       \
+    "    movq pstDirectNext(%rip), %rax\n"                                                                    \
+    "    testq %rax, %rax\n"                                                                                  \
+    "    jz 1f\n"                                                                                             \
+    "    leaq " XSTR(TASK_CONTEXT) "(%rax), %rsi\n"                                                           \
+    "1:\n"
+#define SWITCH_REDIRECT_DONE "    movq $0, pstDirectNext(%rip)\n"
+#else
+#define SWITCH_REDIRECT ""
+#define SWITCH_REDIRECT_DONE ""
+#endif
+
+// The core library calls swapcontext() in task_switch(), this definition is
+// the one it links to. It saves the callee-saved registers, the stack pointer,
+// the return address and the x87/SSE control words, then loads the same from
+// the next context. The argument registers are also loaded, they carry the
+// arguments of a context prepared by makecontext(). On a direct switch the
+// next context is the one of pstDirectNext, which is cleared once its stack
+// is in use.
+__asm__(".text\n"
+        ".globl swapcontext\n"
+        ".type swapcontext, @function\n"
+        "swapcontext:\n"
+        SWITCH_REDIRECT
+        "    movq %rbx, " XSTR(UCTX_RBX) "(%rdi)\n"
+        "    movq %rbp, " XSTR(UCTX_RBP) "(%rdi)\n"
+        "    movq %r12, " XSTR(UCTX_R12) "(%rdi)\n"
+        "    movq %r13, " XSTR(UCTX_R13) "(%rdi)\n"
+        "    movq %r14, " XSTR(UCTX_R14) "(%rdi)\n"
+        "    movq %r15, " XSTR(UCTX_R15) "(%rdi)\n"
+        "    movq (%rsp), %rcx\n"
+        "    movq %rcx, " XSTR(UCTX_RIP) "(%rdi)\n"
+        "    leaq 8(%rsp), %rcx\n"
+        "    movq %rcx, " XSTR(UCTX_RSP) "(%rdi)\n"
+        "    leaq " XSTR(UCTX_FPREGS_MEM) "(%rdi), %rcx\n"
+        "    movq %rcx, " XSTR(UCTX_FPREGS) "(%rdi)\n"
+        "    fnstcw (%rcx)\n"
+        "    stmxcsr " XSTR(UCTX_MXCSR) "(%rdi)\n"
+        "    fldcw " XSTR(UCTX_FPREGS_MEM) "(%rsi)\n"
+        "    ldmxcsr " XSTR(UCTX_MXCSR) "(%rsi)\n"
+        "    movq " XSTR(UCTX_RSP) "(%rsi), %rsp\n"
+        "    movq " XSTR(UCTX_RBX) "(%rsi), %rbx\n"
+        "    movq " XSTR(UCTX_RBP) "(%rsi), %rbp\n"
+        "    movq " XSTR(UCTX_R12) "(%rsi), %r12\n"
+        "    movq " XSTR(UCTX_R13) "(%rsi), %r13\n"
+        "    movq " XSTR(UCTX_R14) "(%rsi), %r14\n"
+        "    movq " XSTR(UCTX_R15) "(%rsi), %r15\n"
+        "    pushq " XSTR(UCTX_RIP) "(%rsi)\n"
+        SWITCH_REDIRECT_DONE
+        "    movq " XSTR(UCTX_RDI) "(%rsi), %rdi\n"
+        "    movq " XSTR(UCTX_RDX) "(%rsi), %rdx\n"
+        "    movq " XSTR(UCTX_RCX) "(%rsi), %rcx\n"
+        "    movq " XSTR(UCTX_R8) "(%rsi), %r8\n"
+        "    movq " XSTR(UCTX_R9) "(%rsi), %r9\n"
+        "    movq " XSTR(UCTX_RSI) "(%rsi), %rsi\n"
+        "    xorl %eax, %eax\n"
+        "    ret\n"
+        ".size swapcontext, .-swapcontext\n");
+#endif
+
+// STATIC FUNCTIONS DEFINITIONS ================================================
+
+static void readyEnqueue(task_t *pstTask)
+{
+    task_group_t *pstGroup = pstTask->pstGroup;
+
+    if (0 != pstTask->uiPeriod)
+    {
+        readyHeapInsert(&(stRunQueue.stEdfHeap), pstTask, (long long)pstTask->uiDeadline);
+        return;
+    }
+
+    if (!pstTask->ucGroupReady)
+    {
+        // A group coming back keeps its virtual runtime, limited to
+        // FAIR_WAKEUP_CREDIT_uS behind the floor, just like a waking task
+        if ((0 == pstGroup->uiReadyTasks) && (ullMinGroupVRuntime > FAIR_WAKEUP_CREDIT_uS) &&
+            (pstGroup->ullVRuntime < (ullMinGroupVRuntime - FAIR_WAKEUP_CREDIT_uS)))
+        {
+            pstGroup->ullVRuntime = ullMinGroupVRuntime - FAIR_WAKEUP_CREDIT_uS;
+        }
+
+        pstTask->ucGroupReady = 1;
+        (pstGroup->uiReadyTasks)++;
+    }
+
+    if (NULL != pstPolicy->enqueue)
+    {
+        groupSelect(pstTask);
+        pstPolicy->enqueue(pstTask);
+    }
+
+    return;
+}
+
+static void readyDequeue(task_t *pstTask)
+{
+    if (0 != pstTask->uiPeriod)
+    {
+        readyHeapRemove(&(stRunQueue.stEdfHeap), pstTask);
+        return;
+    }
+
+    if (pstTask->ucGroupReady)
+    {
+        pstTask->ucGroupReady = 0;
+        (pstTask->pstGroup->uiReadyTasks)--;
+    }
+
+    if (NULL != pstPolicy->dequeue)
+    {
+        groupSelect(pstTask);
+        pstPolicy->dequeue(pstTask);
+    }
+
+    return;
+}
+
+static int taskTick(task_t *pstTask)
+{
+    int iExpired = 0;
+
+    if (0 != pstTask->uiPeriod)
+    {
+        return edfTick(pstTask);
+    }
+
+    // The policy counts every tick, even when the group quota is over
+    iExpired = ((NULL != pstPolicy->on_tick) && pstPolicy->on_tick(pstTask));
+
+    return (groupTick(pstTask) || iExpired);
+}
+
+static task_t *edfPick(void)
+{
+    task_t *pstNextTask = NULL;
+
+    if (0 < stRunQueue.stEdfHeap.iSize)
+    {
+        pstNextTask = stRunQueue.stEdfHeap.pstNodes[1].pstTask;
+        readyHeapRemove(&(stRunQueue.stEdfHeap), pstNextTask);
+    }
+
+    return pstNextTask;
+}
+
+static int edfTick(task_t *pstTask)
+{
+    (pstTask->uiBudgetUsed)++;
+
+    if (pstTask->uiBudgetUsed < pstTask->uiBudget)
+    {
+        return 0;
+    }
+
+    pstTask->uiDeadline += pstTask->uiPeriod;
+    pstTask->uiBudgetUsed = 0;
+
+    return 1;
+}
+
+static void edfCheckRelease(void)
+{
+    ST_ReadyHeap *pstReleases = &(stRunQueue.stEdfReleases);
+
+    if ((0 < pstReleases->iSize) && (pstReleases->pstNodes[1].llKey <= (long long)systemTime))
+    {
+        cPreemptPending = 1;
+    }
+
+    return;
+}
+
+static void edfCheckPreempt(task_t *pstTask)
+{
+    // The dispatcher picks the most urgent task by itself
+    if ((0 == pstTask->uiPeriod) || (taskExec == taskDisp))
+    {
+        return;
+    }
+
+    if ((0 == taskExec->uiPeriod) || (pstTask->uiDeadline < taskExec->uiDeadline))
+    {
+        cPreemptPending = 1;
+
+        if (cTickless)
+        {
+            uiTimerExpiry = 0;
+            ticklessArm(taskExec);
+        }
+    }
+
+    return;
+}
+
+static int piEffectivePrio(task_t *pstTask)
+{
+    int iPrio = pstTask->iBasePrio;
+    mutex_t *pstMutex = pstTask->pstHeldMutexes;
+    task_t *pstWaiter = NULL;
+
+    while (NULL != pstMutex)
+    {
+        pstWaiter = pstMutex->queue;
+
+        if (NULL != pstWaiter)
+        {
+            do
+            {
+                iPrio = (pstWaiter->iStaticPrio < iPrio) ? pstWaiter->iStaticPrio : iPrio;
+                pstWaiter = pstWaiter->next;
+            } while (pstWaiter != pstMutex->queue);
+        }
+
+        pstMutex = pstMutex->pstNextHeld;
+    }
+
+    return iPrio;
+}
+
+static void piSetPrio(task_t *pstTask, int iPrio)
+{
+    char cIsReady = 0;
+
+    if (iPrio == pstTask->iStaticPrio)
+    {
+        return;
+    }
+
+    preemptDisable();
+
+    cIsReady = ((pstTask != taskExec) && (TASK_STATE_READY == pstTask->state));
+
+    if (cIsReady)
+    {
+        readyDequeue(pstTask);
+    }
+
+    // A boost also applies to the aged priority, a drop waits for the next
+    // pick to reset it
+    pstTask->iStaticPrio = iPrio;
+    pstTask->iDinamPrio = (iPrio < pstTask->iDinamPrio) ? iPrio : pstTask->iDinamPrio;
+
+    if (cIsReady)
+    {
+        readyEnqueue(pstTask);
+    }
+
+    preemptEnable();
+
+    return;
+}
+
+static void piBoostChain(task_t *pstTask, mutex_t *pstMutex)
+{
+    int iPrio = pstTask->iStaticPrio;
+    task_t *pstOwner = NULL;
+
+    pstTask->pstBlockedOn = pstMutex;
+
+    // Stops at a free mutex, at an owner that is not blocked or at one that
+    // already runs with this priority, which also ends a deadlock cycle
+    while ((NULL != pstMutex) && (NULL != (pstOwner = pstMutex->pstOwner)) &&
+           (iPrio < pstOwner->iStaticPrio))
+    {
+        piSetPrio(pstOwner, iPrio);
+        pstMutex = pstOwner->pstBlockedOn;
+    }
+
+    return;
+}
+
+static void piHeldRemove(task_t *pstTask, mutex_t *pstMutex)
+{
+    mutex_t **ppstLink = &(pstTask->pstHeldMutexes);
+
+    while ((NULL != *ppstLink) && (pstMutex != *ppstLink))
+    {
+        ppstLink = &((*ppstLink)->pstNextHeld);
+    }
+
+    if (NULL != *ppstLink)
+    {
+        *ppstLink = pstMutex->pstNextHeld;
+    }
+
+    pstMutex->pstNextHeld = NULL;
+
+    return;
+}
+
+static void taskReclaim(void)
+{
+
+    preemptDisable();
+
+#ifdef PPOS_STACK_POOL
+    if (NULL != pvExitedStack)
+    {
+        stackRelease(pvExitedStack, szExitedStack);
+        pvExitedStack = NULL;
+    }
+#endif
+
+    if (NULL != pstExitedTcb)
+    {
+        free(pstExitedTcb);
+        pstExitedTcb = NULL;
+    }
+
+    preemptEnable();
+
+    return;
+}
+
+#ifdef PPOS_DIRECT_SWITCH
+static void directSwitchPrepare(void)
+{
+    task_t *pstNextTask = NULL;
+    task_t *pstSleeper = sleepQueue;
+
+    if ((taskExec == taskDisp) || (NULL == readyQueue))
+    {
+        return;
+    }
+
+    // Sleeping tasks are only woken up by the dispatcher
+    if (NULL != pstSleeper)
+    {
+        do
+        {
+            if (pstSleeper->awakeTime <= systemTime)
+            {
+                return;
+            }
+
+            pstSleeper = pstSleeper->next;
+        } while (pstSleeper != sleepQueue);
+    }
+
+    preemptDisable();
+
+    // The decision depends on the processor time the yielding task has just
+    // used, so it is accounted for first
+    if (cTickless)
+    {
+        ticklessCatchUp();
+    }
+
+    metricsHandler(taskExec, taskDisp);
+    cDirectCharged = 1;
+
+    // The same steps the dispatcher takes with the task scheduler() returns
+    pstNextTask = scheduler();
+
+    if (NULL != pstNextTask)
+    {
+        queue_remove((queue_t **)&readyQueue, (queue_t *)pstNextTask);
+        pstNextTask->queue = NULL;
+        pstNextTask->state = TASK_STATE_EXECUTING;
+        pstDirectNext = pstNextTask;
+    }
+
+    preemptEnable();
+
+    return;
+}
+#endif
+
+#ifdef PPOS_STACK_MOVE
+static void stackReplace(task_t *pstTask, size_t szSize)
+{
+    long lPage = sysconf(_SC_PAGESIZE);
+    greg_t *pllRegs = pstTask->context.uc_mcontext.gregs;
+    greg_t llBody = pllRegs[UCTX_GREG(UCTX_RIP)];
+    greg_t llArg = pllRegs[UCTX_GREG(UCTX_RDI)];
+
+    szSize = (szSize < STACK_MIN_SIZE) ? STACK_MIN_SIZE : szSize;
+    szSize = ((szSize + lPage - 1) / lPage) * lPage;
+
+#ifndef PPOS_STACK_POOL
+    // The stack the core library allocated already has the default size
+    if (STACKSIZE == szSize)
+    {
+        return;
+    }
+#endif
+
+    preemptDisable();
+
+    free(pstTask->context.uc_stack.ss_sp);
+
+    pstTask->context.uc_stack.ss_sp = stackAlloc(szSize);
+    pstTask->context.uc_stack.ss_size = szSize;
+
+    // makecontext() left the body and its argument in the context
+    makecontext(&(pstTask->context), (void (*)(void))llBody, 1, (void *)llArg);
+
+    preemptEnable();
+
+    return;
+}
+
+static void *stackAlloc(size_t szSize)
+{
+#ifdef PPOS_STACK_POOL
+    long lPage = sysconf(_SC_PAGESIZE);
+    char *pcMap = NULL;
+    int i = 0;
+
+    // The most recently released stacks are the ones still in the cache
+    for (i = iStackPoolQty - 1; i >= 0; i--)
+    {
+        if (szSize == aszStackPool[i])
+        {
+            pcMap = (char *)apvStackPool[i];
+            iStackPoolQty--;
+            apvStackPool[i] = apvStackPool[iStackPoolQty];
+            aszStackPool[i] = aszStackPool[iStackPoolQty];
+
+            return pcMap;
+        }
+    }
+
+    pcMap = (char *)mmap(NULL, szSize + lPage, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (MAP_FAILED == pcMap)
+    {
+        perror("Task stack mmap error: ");
+        exit(1);
+    }
+
+    // An overflow faults on the guard page instead of writing over the
+    // memory below the stack
+    if (mprotect(pcMap, lPage, PROT_NONE) < 0)
+    {
+        perror("Task stack mprotect error: ");
+        exit(1);
+    }
+
+    return pcMap + lPage;
+#else
+    // The core library frees it when the task exits
+    void *pvStack = malloc(szSize);
+
+    if (NULL == pvStack)
+    {
+        perror("Task stack malloc error: ");
+        exit(1);
+    }
+
+    return pvStack;
+#endif
+}
+#endif
+
+#ifdef PPOS_STACK_POOL
+static void stackRelease(void *pvStack, size_t szSize)
+{
+    long lPage = sysconf(_SC_PAGESIZE);
+
+    if (STACK_POOL_MAX > iStackPoolQty)
+    {
+        apvStackPool[iStackPoolQty] = pvStack;
+        aszStackPool[iStackPoolQty] = szSize;
+        iStackPoolQty++;
+    }
+    else
+    {
+        munmap((char *)pvStack - lPage, szSize + lPage);
+    }
+
+    return;
+}
+#endif
+
+static void lightRunnerBody(void *pvArg)
+{
+    ltask_t *pstTask = NULL;
+
+    // The runner only leaves its critical section to run a light task
+    preemptDisable();
+
+    for (;;)
+    {
+        pstTask = pstLightReadyHead;
+
+        if (NULL == pstTask)
+        {
+            // Once this is NULL the next light task creates another system
+            // task, this one no longer touches the light task structures
+            if (0 == ulLightTasks)
+            {
+                pstLightRunner = NULL;
+                break;
+            }
+
+            // The same steps sem_down() takes to block the running task
+            cLightRunnerIdle = 1;
+            task_suspend(taskExec, &pstLightIdleQueue);
+            preemptEnable();
+            task_yield();
+            preemptDisable();
+            continue;
+        }
+
+        pstLightReadyHead = pstTask->next;
+        pstLightReadyTail = (NULL == pstLightReadyHead) ? NULL : pstLightReadyTail;
+        pstTask->next = NULL;
+        pstLightCurrent = pstTask;
+        cLightContinued = 0;
+
+        // Before each light task the runner is at a safe point, the light
+        // task API calls don't need one of their own
+        preemptEnable();
+        preemptPoint();
+
+        pstTask->func(pstTask, pstTask->arg);
+
+        // A light task that returned without asking to continue is over, it
+        // may even have been created again already
+        preemptDisable();
+
+        if (!cLightContinued)
+        {
+            ulLightTasks--;
+        }
+
+        pstLightCurrent = NULL;
+    }
+
+    preemptEnable();
+    task_exit(0);
+
+    return;
+}
+
+static void lightReady(ltask_t *pstTask, void (*pfnFunc)(ltask_t *, void *))
+{
+    pstTask->func = pfnFunc;
+    pstTask->next = NULL;
+
+    if (NULL == pstLightReadyTail)
+    {
+        pstLightReadyHead = pstTask;
+    }
+    else
+    {
+        pstLightReadyTail->next = pstTask;
+    }
+
+    pstLightReadyTail = pstTask;
+
+    if (cLightRunnerIdle)
+    {
+        cLightRunnerIdle = 0;
+        task_resume(pstLightRunner);
+    }
+
+    return;
+}
+
+static int lightMayContinue(ltask_t *pstTask)
+{
+    return ((NULL != pstTask) && (pstTask == pstLightCurrent) && !cLightContinued);
+}
+
+static int lightSemWait(ltask_t *pstTask, semaphore_t *pstSem, void (*pfnFunc)(ltask_t *, void *))
+{
+    ST_LightWaitList *pstList = NULL;
+
+    if (!pstSem->active)
+    {
+        pstTask->result = -1;
+        return 1;
+    }
+
+    // A positive value means nobody, light or not, is waiting on it
+    if (0 < pstSem->value)
+    {
+        (pstSem->value)--;
+        pstTask->result = 0;
+        return 1;
+    }
+
+    pstList = &(astLightWaits[((unsigned long)pstSem >> 4) % LTASK_WAIT_BUCKETS]);
+    pstTask->func = pfnFunc;
+    pstTask->pstWaitSem = pstSem;
+    pstTask->next = NULL;
+
+    if (NULL == pstList->pstTail)
+    {
+        pstList->pstHead = pstTask;
+    }
+    else
+    {
+        pstList->pstTail->next = pstTask;
+    }
+
+    pstList->pstTail = pstTask;
+    ulLightWaiters++;
+
+    return 0;
+}
+
+static ltask_t *lightWaitTake(semaphore_t *pstSem)
+{
+    ST_LightWaitList *pstList = &(astLightWaits[((unsigned long)pstSem >> 4) % LTASK_WAIT_BUCKETS]);
+    ltask_t *pstPrev = NULL;
+    ltask_t *pstTask = pstList->pstHead;
+
+    // The bucket keeps FIFO order, so the first one of the semaphore is the
+    // one waiting the longest
+    while ((NULL != pstTask) && (pstSem != pstTask->pstWaitSem))
+    {
+        pstPrev = pstTask;
+        pstTask = pstTask->next;
+    }
+
+    if (NULL != pstTask)
+    {
+        if (NULL == pstPrev)
+        {
+            pstList->pstHead = pstTask->next;
+        }
+        else
+        {
+            pstPrev->next = pstTask->next;
+        }
+
+        if (pstList->pstTail == pstTask)
+        {
+            pstList->pstTail = pstPrev;
+        }
+
+        pstTask->next = NULL;
+        pstTask->pstWaitSem = NULL;
+        ulLightWaiters--;
+    }
+
+    return pstTask;
+}
+
+static int mqueueLayout(mqueue_t *pstQueue, unsigned char ucLayout)
+{
+    int iResult = 0;
+
+    preemptDisable();
+
+    if (MQUEUE_LAYOUT_NONE == pstQueue->layout)
+    {
+        pstQueue->layout = ucLayout;
+
+        // Nobody has waited on them yet. Destroyed, they make the library send
+        // and receive fail on a ring instead of writing a linear queue into it
+        if (MQUEUE_LAYOUT_RING == ucLayout)
+        {
+            sem_destroy(&(pstQueue->sItem));
+            sem_destroy(&(pstQueue->sVaga));
+        }
+    }
+    else if (ucLayout != pstQueue->layout)
+    {
+        iResult = -1;
+    }
+
+    preemptEnable();
+
+    return iResult;
+}
+
+static void mqueueCommit(mqueue_t *pstQueue)
+{
+
+    // The send side and a slot counted in sRingVaga keep everyone else away from
+    // the slot; the section only covers the count, shared with the receivers
+    preemptDisable();
+
+    pstQueue->sender = NULL;
+    pstQueue->tail = (pstQueue->tail + 1) % pstQueue->maxMessages;
+    (pstQueue->countMessages)++;
+
+    sem_up_fast(&(pstQueue->sSend));
+    sem_up_fast(&(pstQueue->sRingItem));
+
+    preemptEnable();
+
+    return;
+}
+
+static void mqueueRelease(mqueue_t *pstQueue)
+{
+
+    preemptDisable();
+
+    pstQueue->receiver = NULL;
+    pstQueue->head = (pstQueue->head + 1) % pstQueue->maxMessages;
+    (pstQueue->countMessages)--;
+
+    sem_up_fast(&(pstQueue->sRecv));
+    sem_up_fast(&(pstQueue->sRingVaga));
+
+    preemptEnable();
+
+    return;
+}
+
+static void lightSendSlot(ltask_t *pstTask, void *pvArg)
+{
+
+    preemptDisable();
+
+    // Run by the system task, this step asks to continue for the light task
+    cLightContinued = 1;
+
+    if (0 > pstTask->result)
+    {
+        lightReady(pstTask, pstTask->pfnDone);
+    }
+    else if (lightSemWait(pstTask, &(pstTask->pstMqueue->sBuffer), lightSendCopy))
+    {
+        lightSendCopy(pstTask, pvArg);
+    }
+
+    preemptEnable();
+
+    return;
+}
+
+static void lightSendCopy(ltask_t *pstTask, void *pvArg)
+{
+    mqueue_t *pstQueue = pstTask->pstMqueue;
+    char cCopied = (0 <= pstTask->result);
+
+    preemptDisable();
+
+    cLightContinued = 1;
+
+    if (cCopied)
+    {
+        memcpy((char *)pstQueue->content + (pstQueue->countMessages * pstQueue->messageSize), pstTask->pvMsg,
+               pstQueue->messageSize);
+        (pstQueue->countMessages)++;
+    }
+
+    lightReady(pstTask, pstTask->pfnDone);
+
+    // sem_up() only ends the critical section of the core library, this one
+    // stays open until the light task is queued
+    if (cCopied)
+    {
+        sem_up(&(pstQueue->sBuffer));
+        sem_up(&(pstQueue->sItem));
+    }
+
+    preemptEnable();
+
+    return;
+}
+
+static void lightRecvItem(ltask_t *pstTask, void *pvArg)
+{
+
+    preemptDisable();
+
+    cLightContinued = 1;
+
+    if (0 > pstTask->result)
+    {
+        lightReady(pstTask, pstTask->pfnDone);
+    }
+    else if (lightSemWait(pstTask, &(pstTask->pstMqueue->sBuffer), lightRecvCopy))
+    {
+        lightRecvCopy(pstTask, pvArg);
+    }
+
+    preemptEnable();
+
+    return;
+}
+
+static void lightRecvCopy(ltask_t *pstTask, void *pvArg)
+{
+    mqueue_t *pstQueue = pstTask->pstMqueue;
+    char cCopied = (0 <= pstTask->result);
+
+    preemptDisable();
+
+    cLightContinued = 1;
+
+    if (cCopied)
+    {
+        (pstQueue->countMessages)--;
+        memcpy(pstTask->pvMsg, pstQueue->content, pstQueue->messageSize);
+        memmove(pstQueue->content, (char *)pstQueue->content + pstQueue->messageSize,
+                pstQueue->countMessages * pstQueue->messageSize);
+    }
+
+    lightReady(pstTask, pstTask->pfnDone);
+
+    if (cCopied)
+    {
+        sem_up(&(pstQueue->sBuffer));
+        sem_up(&(pstQueue->sVaga));
+    }
+
+    preemptEnable();
+
+    return;
+}
+
+static void groupSelect(task_t *pstTask)
+{
+    pstCurRunQueue = (ST_RunQueue *)pstTask->pstGroup->pvRunQueue;
+
+    return;
+}
+
+static void groupRefill(task_group_t *pstGroup)
+{
+    unsigned int uiElapsed = systemTime - pstGroup->uiPeriodStart;
+
+    if ((0 != pstGroup->quota) && (uiElapsed >= pstGroup->period))
+    {
+        pstGroup->uiPeriodStart = systemTime - (uiElapsed % pstGroup->period);
+        pstGroup->uiQuotaUsed = 0;
+    }
+
+    return;
+}
+
+static task_t *groupPick(char *pcThrottled)
+{
+    task_group_t *pstGroup = NULL;
+    task_group_t *pstBest = NULL;
+
+    *pcThrottled = 0;
+
+    for (pstGroup = pstGroups; NULL != pstGroup; pstGroup = pstGroup->pstNext)
+    {
+        if (0 == pstGroup->uiReadyTasks)
+        {
+            continue;
+        }
+
+        groupRefill(pstGroup);
+
+        if ((0 != pstGroup->quota) && (pstGroup->uiQuotaUsed >= pstGroup->quota))
+        {
+            *pcThrottled = 1;
+            continue;
+        }
+
+        if ((NULL == pstBest) || (pstGroup->ullVRuntime < pstBest->ullVRuntime))
+        {
+            pstBest = pstGroup;
+        }
+    }
+
+    if (NULL == pstBest)
+    {
+        return NULL;
+    }
+
+    if (pstBest->ullVRuntime > ullMinGroupVRuntime)
+    {
+        ullMinGroupVRuntime = pstBest->ullVRuntime;
+    }
+
+    pstCurRunQueue = (ST_RunQueue *)pstBest->pvRunQueue;
+
+    return pstPolicy->pick_next();
+}
+
+static int groupTick(task_t *pstTask)
+{
+    task_group_t *pstGroup = pstTask->pstGroup;
+    unsigned int uiStart = uiTaskStartingTick;
+
+    if ((NULL == pstGroup) || (0 == pstGroup->quota))
+    {
+        return 0;
+    }
+
+    groupRefill(pstGroup);
+
+    // Only the part of the burst inside the current period counts
+    uiStart = (uiStart < pstGroup->uiPeriodStart) ? pstGroup->uiPeriodStart : uiStart;
+
+    return ((pstGroup->uiQuotaUsed + (systemTime - uiStart)) >= pstGroup->quota);
+}
+
+static void groupCharge(task_t *pstTask, unsigned int uiUsedTicks)
+{
+    task_group_t *pstGroup = pstTask->pstGroup;
+
+    if (NULL == pstGroup)
+    {
+        return;
+    }
+
+    pstGroup->usage += uiUsedTicks;
+
+    // Real-time tasks are scheduled apart from the groups
+    if (0 != pstTask->uiPeriod)
+    {
+        return;
+    }
+
+    // Groups with more shares have a slower virtual clock
+    pstGroup->ullVRuntime += ((unsigned long long)uiUsedTicks * 1000 * FAIR_NICE_0_WEIGHT) / pstGroup->shares;
+
+    if (0 != pstGroup->quota)
+    {
+        groupRefill(pstGroup);
+
+        if (uiTaskStartingTick < pstGroup->uiPeriodStart)
+        {
+            uiUsedTicks = systemTime - pstGroup->uiPeriodStart;
+        }
+
+        pstGroup->uiQuotaUsed += uiUsedTicks;
+    }
+
+    return;
+}
+
+static unsigned int groupNextEvent(task_t *pstNextTask)
+{
+    unsigned int uiDelay = TICKLESS_MAX_DEFER_MS;
+    unsigned int uiLeft = 0;
+    task_group_t *pstGroup = NULL;
+
+    // The quota left to the group of the task about to run
+    pstGroup = pstNextTask->pstGroup;
+
+    if ((pstNextTask != taskDisp) && (0 == pstNextTask->uiPeriod) && (NULL != pstGroup) &&
+        (0 != pstGroup->quota))
+    {
+        uiLeft = (pstGroup->uiQuotaUsed < pstGroup->quota) ? (pstGroup->quota - pstGroup->uiQuotaUsed) : 0;
+
+        if ((pstNextTask == taskExec) && (uiTaskStartingTick < systemTime))
+        {
+            uiLeft = (uiLeft > (systemTime - uiTaskStartingTick)) ? (uiLeft - (systemTime - uiTaskStartingTick)) : 0;
+        }
+
+        uiDelay = (uiLeft < uiDelay) ? uiLeft : uiDelay;
+    }
+
+    // The refill of the throttled groups with ready tasks
+    for (pstGroup = pstGroups; NULL != pstGroup; pstGroup = pstGroup->pstNext)
+    {
+        if ((0 != pstGroup->quota) && (0 != pstGroup->uiReadyTasks) &&
+            (pstGroup->uiQuotaUsed >= pstGroup->quota))
+        {
+            uiLeft = pstGroup->uiPeriodStart + pstGroup->period - systemTime;
+            uiDelay = (uiLeft < uiDelay) ? uiLeft : uiDelay;
+        }
+    }
+
+    return (0 == uiDelay) ? 1 : uiDelay;
+}
+
+static int schedGroupAware(void)
+{
+    return ((pstPolicy == &stAgingHeapPolicy) || (pstPolicy == &stAgingBitmapPolicy) ||
+            (pstPolicy == &stFairPolicy) || (pstPolicy == &stFifoPolicy) ||
+            (pstPolicy == &stRoundRobinPolicy));
+}
+
+static sched_policy_t *schedFind(const char *pcName)
+{
+    int i = 0;
+
+    if (NULL == pcName)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < iPoliciesQty; i++)
+    {
+        if (0 == strcmp(apstPolicies[i]->name, pcName))
+        {
+            return apstPolicies[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void agingHeapEnqueue(task_t *pstTask)
+{
+    ST_ReadyHeap *pstHeap = &(pstCurRunQueue->stHeap);
+
+    // The key is shifted by the current epoch, so the aging of the following
+    // picks doesn't need to touch the task
+    readyHeapInsert(pstHeap, pstTask, pstTask->iDinamPrio - (UNIX_AGING_FACTOR * pstHeap->llEpoch));
+
+    return;
+}
+
+static void agingHeapDequeue(task_t *pstTask)
+{
+    ST_ReadyHeap *pstHeap = &(pstCurRunQueue->stHeap);
+
+    if (0 != pstTask->iHeapIdx)
+    {
+        pstTask->iDinamPrio = (int)(readyHeapRemove(pstHeap, pstTask) +
+                                    (UNIX_AGING_FACTOR * pstHeap->llEpoch));
+    }
+
+    return;
+}
+
+static task_t *agingHeapPick(void)
+{
+    ST_ReadyHeap *pstHeap = &(pstCurRunQueue->stHeap);
+    task_t *pstNextTask = NULL;
+
+    if (0 < pstHeap->iSize)
+    {
+        pstNextTask = pstHeap->pstNodes[1].pstTask;
+        readyHeapRemove(pstHeap, pstNextTask);
+        pstNextTask->iDinamPrio = pstNextTask->iStaticPrio;
+        quantumStart(pstNextTask);
+
+        // Every task left in the heap gets older without being touched
+        (pstHeap->llEpoch)++;
+    }
+
+    return pstNextTask;
+}
+
+static void agingBitmapEnqueue(task_t *pstTask)
+{
+    bitmapInsert(&(pstCurRunQueue->stBitmap), pstTask);
+
+    return;
+}
+
+static void agingBitmapDequeue(task_t *pstTask)
+{
+    bitmapRemove(&(pstCurRunQueue->stBitmap), pstTask);
+
+    return;
+}
+
+static task_t *agingBitmapPick(void)
+{
+    task_t *pstNextTask = bitmapPick(&(pstCurRunQueue->stBitmap));
+
+    if (NULL != pstNextTask)
+    {
+        pstNextTask->iDinamPrio = pstNextTask->iStaticPrio;
+        quantumStart(pstNextTask);
+    }
+
+    return pstNextTask;
+}
+
+static void fairEnqueue(task_t *pstTask)
+{
+    if (0 == pstTask->iHeapIdx)
+    {
+        readyHeapInsert(&(pstCurRunQueue->stHeap), pstTask, (long long)pstTask->ullVRuntime);
+        pstCurRunQueue->ullReadyWeight += fairWeight(pstTask);
+    }
+
+    return;
+}
+
+static void fairDequeue(task_t *pstTask)
+{
+    if (0 != pstTask->iHeapIdx)
+    {
+        readyHeapRemove(&(pstCurRunQueue->stHeap), pstTask);
+        pstCurRunQueue->ullReadyWeight -= fairWeight(pstTask);
+    }
+
+    return;
+}
+
+static task_t *fairPick(void)
+{
+    task_t *pstNextTask = NULL;
+
+    if (0 < pstCurRunQueue->stHeap.iSize)
+    {
+        pstNextTask = pstCurRunQueue->stHeap.pstNodes[1].pstTask;
+        fairDequeue(pstNextTask);
+
+        if (pstNextTask->ullVRuntime > pstCurRunQueue->ullMinVRuntime)
+        {
+            pstCurRunQueue->ullMinVRuntime = pstNextTask->ullVRuntime;
+        }
+
+        iTaskTicksQty = fairSlice(pstCurRunQueue, pstNextTask);
+    }
+
+    return pstNextTask;
+}
+
+static void fairWake(task_t *pstTask)
+{
+    unsigned long long ullFloor = pstCurRunQueue->ullMinVRuntime;
+
+    ullFloor = (ullFloor > FAIR_WAKEUP_CREDIT_uS) ? (ullFloor - FAIR_WAKEUP_CREDIT_uS) : 0;
+
+    if (pstTask->ullVRuntime < ullFloor)
+    {
+        pstTask->ullVRuntime = ullFloor;
+    }
+
+    return;
+}
+
+static void fifoEnqueue(task_t *pstTask)
+{
+    readyHeapInsert(&(pstCurRunQueue->stHeap), pstTask, 0);
+
+    return;
+}
+
+static void fifoDequeue(task_t *pstTask)
+{
+    readyHeapRemove(&(pstCurRunQueue->stHeap), pstTask);
+
+    return;
+}
+
+static task_t *fifoPick(void)
+{
+    ST_ReadyHeap *pstHeap = &(pstCurRunQueue->stHeap);
+    task_t *pstNextTask = NULL;
+
+    if (0 < pstHeap->iSize)
+    {
+        pstNextTask = pstHeap->pstNodes[1].pstTask;
+        readyHeapRemove(pstHeap, pstNextTask);
+        quantumStart(pstNextTask);
+    }
+
+    return pstNextTask;
+}
+
+static void quantumStart(task_t *pstTask)
+{
+    if (NULL != pstTask)
+    {
+        iTaskTicksQty = pstTask->iQuantumTicks;
+    }
+
+    return;
+}
+
+static void quantumAdapt(task_t *pstTask, unsigned int uiUsedTicks)
+{
+    int iQuantum = pstTask->iQuantumTicks;
+
+    // Average of the last bursts, the newest one weighting a quarter
+    pstTask->uiAvgBurstTicks = ((3 * pstTask->uiAvgBurstTicks) + uiUsedTicks) / 4;
+
+    if (cQuantumExpired)
+    {
+        pstTask->ucBehavior = PPOS_TASK_CPU_BOUND;
+        iQuantum *= 2;
+    }
+    else if ((TASK_STATE_SUSPENDED == pstTask->state) && ((2 * pstTask->uiAvgBurstTicks) < iQuantum))
+    {
+        pstTask->ucBehavior = PPOS_TASK_IO_BOUND;
+        iQuantum = (2 * pstTask->uiAvgBurstTicks) + 1;
+    }
+
+    iQuantum = (iQuantum < QUANTUM_MIN_TICKS) ? QUANTUM_MIN_TICKS : iQuantum;
+    iQuantum = (iQuantum > QUANTUM_MAX_TICKS) ? QUANTUM_MAX_TICKS : iQuantum;
+    pstTask->iQuantumTicks = iQuantum;
+
+    return;
+}
+
+static int quantumTick(task_t *pstTask)
+{
+    iTaskTicksQty--;
+
+    return (0 >= iTaskTicksQty);
+}
+
+static void readyHeapInsert(ST_ReadyHeap *pstHeap, task_t *pstTask, long long llKey)
+{
+
+    if ((NULL == pstTask) || (0 != pstTask->iHeapIdx))
+    {
+        return;
+    }
+
+    preemptDisable();
+
+    if (pstHeap->iSize + 1 >= pstHeap->iCapacity)
+    {
+        int iNewCapacity = (0 == pstHeap->iCapacity) ? READY_HEAP_INITIAL_SIZE
+                                                     : (2 * pstHeap->iCapacity);
+        ST_HeapNode *pstNewNodes = (ST_HeapNode *)realloc(pstHeap->pstNodes,
+                                                          iNewCapacity * sizeof(ST_HeapNode));
+
+        if (NULL == pstNewNodes)
+        {
+            perror("Ready heap realloc error: ");
+            exit(1);
+        }
+
+        pstHeap->pstNodes = pstNewNodes;
+        pstHeap->iCapacity = iNewCapacity;
+    }
+
+    (pstHeap->iSize)++;
+    pstHeap->pstNodes[pstHeap->iSize].pstTask = pstTask;
+    pstHeap->pstNodes[pstHeap->iSize].llKey = llKey;
+    pstHeap->pstNodes[pstHeap->iSize].ulSeq = (pstHeap->ulSeq)++;
+    pstTask->iHeapIdx = pstHeap->iSize;
+
+    readyHeapSiftUp(pstHeap, pstHeap->iSize);
+
+    preemptEnable();
+
+    return;
+}
+
+static long long readyHeapRemove(ST_ReadyHeap *pstHeap, task_t *pstTask)
+{
+    long long llKey = 0;
+    int iIdx = 0;
+
+    if ((NULL == pstTask) || (0 == pstTask->iHeapIdx))
+    {
+        return 0;
+    }
+
+    preemptDisable();
+
+    iIdx = pstTask->iHeapIdx;
+    llKey = pstHeap->pstNodes[iIdx].llKey;
+
+    readyHeapSwap(pstHeap, iIdx, pstHeap->iSize);
+    (pstHeap->iSize)--;
+    pstTask->iHeapIdx = 0;
+
+    if (iIdx <= pstHeap->iSize)
+    {
+        readyHeapSiftUp(pstHeap, iIdx);
+        readyHeapSiftDown(pstHeap, iIdx);
+    }
+
+    preemptEnable();
+
+    return llKey;
+}
+
+static int readyHeapPrecedes(ST_ReadyHeap *pstHeap, int iFirst, int iSecond)
+{
+    ST_HeapNode *pstFirst = &(pstHeap->pstNodes[iFirst]);
+    ST_HeapNode *pstSecond = &(pstHeap->pstNodes[iSecond]);
+
+    // Same priority is decided by arrival, just like the readyQueue order
+    return ((pstFirst->llKey < pstSecond->llKey) ||
+            ((pstFirst->llKey == pstSecond->llKey) && (pstFirst->ulSeq < pstSecond->ulSeq)));
+}
+
+static void readyHeapSwap(ST_ReadyHeap *pstHeap, int iFirst, int iSecond)
+{
+    ST_HeapNode stAux = pstHeap->pstNodes[iFirst];
+
+    pstHeap->pstNodes[iFirst] = pstHeap->pstNodes[iSecond];
+    pstHeap->pstNodes[iSecond] = stAux;
+
+    pstHeap->pstNodes[iFirst].pstTask->iHeapIdx = iFirst;
+    pstHeap->pstNodes[iSecond].pstTask->iHeapIdx = iSecond;
+
+    return;
+}
+
+static void readyHeapSiftUp(ST_ReadyHeap *pstHeap, int iIdx)
+{
+    while ((1 < iIdx) && readyHeapPrecedes(pstHeap, iIdx, iIdx / 2))
+    {
+        readyHeapSwap(pstHeap, iIdx, iIdx / 2);
+        iIdx /= 2;
+    }
+
+    return;
+}
+
+static void readyHeapSiftDown(ST_ReadyHeap *pstHeap, int iIdx)
+{
+    int iChild = 2 * iIdx;
+
+    while (iChild <= pstHeap->iSize)
+    {
+        if ((iChild < pstHeap->iSize) && readyHeapPrecedes(pstHeap, iChild + 1, iChild))
+        {
+            iChild++;
+        }
+
+        if (!readyHeapPrecedes(pstHeap, iChild, iIdx))
+        {
+            break;
+        }
+
+        readyHeapSwap(pstHeap, iIdx, iChild);
+        iIdx = iChild;
+        iChild = 2 * iIdx;
+    }
+
+    return;
+}
+
+static void bitmapInit(ST_BitmapQueues *pstQueues)
+{
+    int i = 0;
+
+    for (i = 0; i < BITMAP_SLOTS; i++)
+    {
+        pstQueues->astSlots[i].prev = &(pstQueues->astSlots[i]);
+        pstQueues->astSlots[i].next = &(pstQueues->astSlots[i]);
+    }
+
+    pstQueues->ullBitmap = 0;
+    pstQueues->iBase = 0;
+
+    return;
+}
+
+static void bitmapInsert(ST_BitmapQueues *pstQueues, task_t *pstTask)
+{
+    int iPrio = 0;
+    int iSlot = 0;
+    queue_t *pstSlot = NULL;
+    queue_t *pstLink = NULL;
+
+    if ((NULL == pstTask) || (NULL != pstTask->stRunLink.next))
+    {
+        return;
+    }
+
+    preemptDisable();
+
+    iPrio = pstTask->iDinamPrio;
+    iPrio = (iPrio < UNIX_MIN_PRIO) ? UNIX_MIN_PRIO : iPrio;
+    iPrio = (iPrio > UNIX_MAX_PRIO) ? UNIX_MAX_PRIO : iPrio;
+
+    iSlot = (pstQueues->iBase + (iPrio - UNIX_MIN_PRIO)) % BITMAP_SLOTS;
+    pstSlot = &(pstQueues->astSlots[iSlot]);
+    pstLink = &(pstTask->stRunLink);
+
+    pstLink->prev = pstSlot->prev;
+    pstLink->next = pstSlot;
+    pstSlot->prev->next = pstLink;
+    pstSlot->prev = pstLink;
+
+    pstQueues->ullBitmap |= (1ULL << iSlot);
+
+    preemptEnable();
+
+    return;
+}
+
+static void bitmapRemove(ST_BitmapQueues *pstQueues, task_t *pstTask)
+{
+    queue_t *pstLink = NULL;
+
+    if ((NULL == pstTask) || (NULL == pstTask->stRunLink.next))
+    {
+        return;
+    }
+
+    preemptDisable();
+
+    pstLink = &(pstTask->stRunLink);
+    pstLink->prev->next = pstLink->next;
+    pstLink->next->prev = pstLink->prev;
+
+    // Only the slot head is left when both neighbours are the same node
+    if (pstLink->prev == pstLink->next)
+    {
+        pstQueues->ullBitmap &= ~(1ULL << (pstLink->prev - pstQueues->astSlots));
+    }
+
+    pstLink->prev = NULL;
+    pstLink->next = NULL;
+
+    preemptEnable();
+
+    return;
+}
+
+static task_t *bitmapPick(ST_BitmapQueues *pstQueues)
+{
+    int iBase = pstQueues->iBase;
+    int iNextBase = (iBase + 1) % BITMAP_SLOTS;
+    unsigned long long ullRotated = pstQueues->ullBitmap;
+    queue_t *pstTop = &(pstQueues->astSlots[iBase]);
+    queue_t *pstSecond = &(pstQueues->astSlots[iNextBase]);
+    task_t *pstTask = NULL;
+
+    if (0 == ullRotated)
+    {
+        return NULL;
+    }
+
+    // Rotates the occupancy word so bit 0 is the highest priority level
+    if (0 != iBase)
+    {
+        ullRotated = (ullRotated >> iBase) | (ullRotated << (BITMAP_SLOTS - iBase));
+    }
+
+    pstTask = (task_t *)((char *)(pstQueues->astSlots[(iBase + __builtin_ctzll(ullRotated)) % BITMAP_SLOTS].next) -
+                         offsetof(task_t, stRunLink));
+    bitmapRemove(pstQueues, pstTask);
+
+    // Aging: the top level is spliced in front of the next one, which becomes
+    // the new top level, so every waiting task climbs one level at once
+    if (pstTop->next != pstTop)
+    {
+        pstTop->prev->next = pstSecond->next;
+        pstSecond->next->prev = pstTop->prev;
+        pstSecond->next = pstTop->next;
+        pstTop->next->prev = pstSecond;
+
+        pstTop->prev = pstTop;
+        pstTop->next = pstTop;
+
+        pstQueues->ullBitmap &= ~(1ULL << iBase);
+        pstQueues->ullBitmap |= (1ULL << iNextBase);
+    }
+
+    pstQueues->iBase = iNextBase;
+
+    return pstTask;
+}
+
+static void queueUnlink(task_t **ppstQueue, task_t *pstTask)
+{
+    if (pstTask->next == pstTask)
+    {
+        *ppstQueue = NULL;
+    }
+    else
+    {
+        pstTask->prev->next = pstTask->next;
+        pstTask->next->prev = pstTask->prev;
+
+        if (*ppstQueue == pstTask)
+        {
+            *ppstQueue = pstTask->next;
+        }
+    }
+
+    pstTask->prev = NULL;
+    pstTask->next = NULL;
+
+    return;
+}
+
+static void wheelInit(void)
+{
+    int i = 0;
+
+    for (i = 0; i < WHEEL_SLOTS; i++)
+    {
+        astWheelSlots[i].prev = &(astWheelSlots[i]);
+        astWheelSlots[i].next = &(astWheelSlots[i]);
+    }
+
+    memset(aullWheelBitmap, 0, sizeof(aullWheelBitmap));
+    uiWheelNow = 0;
+    uiWheelTasks = 0;
+
+    // The sentinel is never created, it only goes through task_resume()
+    stWheelSentinel.id = -1;
+    stWheelSentinel.state = TASK_STATE_SUSPENDED;
+    stWheelSentinel.queue = NULL;
+
+    return;
+}
+
+static int wheelSlot(unsigned int uiExpiry)
+{
+    unsigned int uiDelay = uiExpiry - uiWheelNow;
+    int iShift = WHEEL_L0_BITS;
+    int iBase = WHEEL_L0_SLOTS;
+
+    if (uiDelay < WHEEL_L0_SLOTS)
+    {
+        return (int)(uiExpiry & (WHEEL_L0_SLOTS - 1));
+    }
+
+    if (uiDelay >= WHEEL_SPAN_MS)
+    {
+        uiDelay = WHEEL_SPAN_MS - 1;
+        uiExpiry = uiWheelNow + uiDelay;
+    }
+
+    while (uiDelay >= (1U << (iShift + WHEEL_LN_BITS)))
+    {
+        iShift += WHEEL_LN_BITS;
+        iBase += WHEEL_LN_SLOTS;
+    }
+
+    return iBase + (int)((uiExpiry >> iShift) & (WHEEL_LN_SLOTS - 1));
+}
+
+static void wheelInsert(task_t *pstTask)
+{
+    int iSlot = 0;
+    queue_t *pstSlot = NULL;
+    queue_t *pstLink = &(pstTask->stTimerLink);
+
+    iSlot = wheelSlot(pstTask->awakeTime);
+    pstSlot = &(astWheelSlots[iSlot]);
+
+    pstLink->prev = pstSlot->prev;
+    pstLink->next = pstSlot;
+    pstSlot->prev->next = pstLink;
+    pstSlot->prev = pstLink;
+
+    aullWheelBitmap[iSlot / 64] |= (1ULL << (iSlot % 64));
+    uiWheelTasks++;
+
+    return;
+}
+
+static void wheelRemove(task_t *pstTask)
+{
+    queue_t *pstLink = NULL;
+    int iSlot = 0;
+
+    if ((NULL == pstTask) || (NULL == pstTask->stTimerLink.next))
+    {
+        return;
+    }
+
+    pstLink = &(pstTask->stTimerLink);
+    pstLink->prev->next = pstLink->next;
+    pstLink->next->prev = pstLink->prev;
+
+    // Only the slot head is left when both neighbours are the same node
+    if (pstLink->prev == pstLink->next)
+    {
+        iSlot = (int)(pstLink->prev - astWheelSlots);
+        aullWheelBitmap[iSlot / 64] &= ~(1ULL << (iSlot % 64));
+    }
+
+    pstLink->prev = NULL;
+    pstLink->next = NULL;
+    uiWheelTasks--;
+
+    return;
+}
+
+static unsigned int wheelNextEvent(void)
+{
+    int iNow = (int)(uiWheelNow & (WHEEL_L0_SLOTS - 1));
+    unsigned int uiDelay = WHEEL_L0_SLOTS;
+    unsigned int uiSlotDelay = 0;
+    unsigned long long ullBits = 0;
+    int iWord = 0;
+    int i = 0;
+
+    for (i = WHEEL_L0_SLOTS / 64; i < WHEEL_SLOTS / 64; i++)
+    {
+        if (0 != aullWheelBitmap[i])
+        {
+            uiDelay = (WHEEL_L0_SLOTS - iNow) & (WHEEL_L0_SLOTS - 1);
+            break;
+        }
+    }
+
+    // The first level is searched from the current slot on, the slots before
+    // it belong to the next turn
+    for (i = 0; i <= WHEEL_L0_SLOTS / 64; i++)
+    {
+        iWord = ((iNow / 64) + i) % (WHEEL_L0_SLOTS / 64);
+        ullBits = aullWheelBitmap[iWord];
+
+        if (0 == i)
+        {
+            ullBits &= (~0ULL << (iNow % 64));
+        }
+        else if ((WHEEL_L0_SLOTS / 64) == i)
+        {
+            ullBits &= ((1ULL << (iNow % 64)) - 1);
+        }
+
+        if (0 != ullBits)
+        {
+            uiSlotDelay = (unsigned int)((iWord * 64) + __builtin_ctzll(ullBits) - iNow) & (WHEEL_L0_SLOTS - 1);
+            uiDelay = (uiSlotDelay < uiDelay) ? uiSlotDelay : uiDelay;
+            break;
+        }
+    }
+
+    return uiWheelNow + uiDelay;
+}
+
+static void wheelCascade(int iSlot)
+{
+    queue_t *pstSlot = &(astWheelSlots[iSlot]);
+    task_t *pstTask = NULL;
+
+    while (pstSlot->next != pstSlot)
+    {
+        pstTask = (task_t *)((char *)(pstSlot->next) - offsetof(task_t, stTimerLink));
+        wheelRemove(pstTask);
+        wheelInsert(pstTask);
+    }
+
+    return;
 }
 
-int after_sem_create(semaphore_t *s, int value)
+static void wheelExpire(unsigned int uiTime)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nsem_create - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    unsigned int uiNext = 0;
+    queue_t *pstSlot = NULL;
+    task_t *pstTask = NULL;
+    int iLevel = 0;
+    int iShift = 0;
+
+    // Only the slots with tasks and the turns of the first level are visited
+    while ((0 != uiWheelTasks) && ((uiNext = wheelNextEvent()) <= uiTime))
+    {
+        uiWheelNow = uiNext;
+
+        // Each level cascades when the one below it completes a turn, the
+        // highest ones first
+        for (iLevel = WHEEL_LEVELS - 1; iLevel > 0; iLevel--)
+        {
+            iShift = WHEEL_L0_BITS + (iLevel - 1) * WHEEL_LN_BITS;
+
+            if (0 == (uiWheelNow & ((1U << iShift) - 1)))
+            {
+                wheelCascade(WHEEL_L0_SLOTS + (iLevel - 1) * WHEEL_LN_SLOTS +
+                             (int)((uiWheelNow >> iShift) & (WHEEL_LN_SLOTS - 1)));
+            }
+        }
+
+        pstSlot = &(astWheelSlots[uiWheelNow & (WHEEL_L0_SLOTS - 1)]);
+
+        while (pstSlot->next != pstSlot)
+        {
+            pstTask = (task_t *)((char *)(pstSlot->next) - offsetof(task_t, stTimerLink));
+            wheelRemove(pstTask);
+
+            // A task in a timed wait is still in the queue of the primitive,
+            // which is fixed once task_resume() took the task out of it
+            pstTask->ucTimedOut = (NULL != pstTask->queue);
+            task_resume(pstTask);
+
+            if (pstTask->ucTimedOut && (NULL != pstTask->pfnTimedOut))
+            {
+                pstTask->pfnTimedOut(pstTask);
+            }
+        }
+
+        uiWheelNow++;
+    }
+
+    if (uiWheelNow <= uiTime)
+    {
+        uiWheelNow = uiTime + 1;
+    }
+
+    wheelArm();
+
+    return;
 }
 
-int before_sem_down(semaphore_t *s)
+static void wheelArm(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nsem_down - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    if (0 == uiWheelTasks)
+    {
+        return;
+    }
+
+    // A shot that fired while the sentinel was out of sleepQueue is served
+    // on the next pass
+    wheelSentinelAt(cShotDue ? systemTime : wheelNextEvent());
+
+    return;
 }
 
-int after_sem_down(semaphore_t *s)
+static void wheelSentinelAt(unsigned int uiTime)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nsem_down - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    task_t *pstSentinel = &stWheelSentinel;
+
+    pstSentinel->awakeTime = uiTime;
+
+    if (NULL == pstSentinel->queue)
+    {
+        queue_append((queue_t **)&sleepQueue, (queue_t *)pstSentinel);
+        pstSentinel->queue = (task_t *)&sleepQueue;
+        pstSentinel->state = TASK_STATE_SUSPENDED;
+    }
+
+    return;
 }
 
-int before_sem_up(semaphore_t *s)
+static void wheelSchedule(task_t *pstTask)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nsem_up - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    // An empty wheel starts again from the current time
+    if (0 == uiWheelTasks)
+    {
+        uiWheelNow = systemTime;
+    }
+
+    wheelInsert(pstTask);
+    wheelArm();
+
+    return;
 }
 
-int after_sem_up(semaphore_t *s)
+static unsigned int deadlineTick(unsigned long long ullDeadline)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nsem_up - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    unsigned long long ullTickNs = 0;
+    unsigned long long ullDelay = 0;
+
+    if (cTickless)
+    {
+        ticklessClockUpdate();
+    }
+
+    if (ullDeadline <= systime_ns())
+    {
+        return systemTime;
+    }
+
+    // Monotonic clock of the tick that set systemTime. The first tick of the
+    // periodic timer comes one period after ppos_init(), the origin.
+    if (cTickless)
+    {
+        ullTickNs = (unsigned long long)systemTime * CLOCK_NS_PER_MS;
+    }
+    else if (0 != ullFirstTickNs)
+    {
+        ullTickNs = ullFirstTickNs + ((unsigned long long)(systemTime - uiFirstTick) * CLOCK_NS_PER_MS);
+    }
+
+    ullDelay = (ullDeadline > ullTickNs) ? ((ullDeadline - ullTickNs + CLOCK_NS_PER_MS - 1) / CLOCK_NS_PER_MS) : 1;
+    ullDelay = (ullDelay > DEADLINE_MAX_DELAY_MS) ? DEADLINE_MAX_DELAY_MS : ullDelay;
+
+    return systemTime + (unsigned int)ullDelay;
 }
 
-int before_sem_destroy(semaphore_t *s)
+static int timedWait(task_t **ppstQueue, unsigned long long ullDeadline, unsigned int uiTick, void *pvWait,
+                     void (*pfnTimedOut)(task_t *))
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nsem_destroy - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    task_t *pstTask = taskExec;
+
+    task_suspend(pstTask, ppstQueue);
+
+    // The task waits in the queue and in the timing wheel at once, the first
+    // one to wake it up takes it out of the other
+    pstTask->awakeTime = uiTick;
+    pstTask->pvTimedWait = pvWait;
+    pstTask->pfnTimedOut = pfnTimedOut;
+    pstTask->ucTimedOut = 0;
+    wheelSchedule(pstTask);
+
+    preemptEnable();
+    task_yield();
+
+    pstTask->pvTimedWait = NULL;
+    pstTask->pfnTimedOut = NULL;
+
+    // The tick of the deadline may come some microseconds before it on the
+    // monotonic clock, a wait never ends early
+    if (pstTask->ucTimedOut)
+    {
+        task_sleep_until(ullDeadline);
+    }
+
+    return pstTask->ucTimedOut;
 }
 
-int after_sem_destroy(semaphore_t *s)
+static inline int casInt(int *piWord, int iOld, int iNew)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nsem_destroy - AFTER - [%d]", taskExec->id);
+#if defined(__x86_64__)
+    unsigned char ucSwapped = 0;
+
+    // Every task runs on the one thread of the process, which a signal only
+    // interrupts between two instructions, so no lock prefix is needed
+    __asm__ __volatile__("cmpxchgl %3, %1\n\t"
+                         "sete %0"
+                         : "=q"(ucSwapped), "+m"(*piWord), "+a"(iOld)
+                         : "r"(iNew)
+                         : "memory", "cc");
+
+    return ucSwapped;
+#else
+    return __atomic_compare_exchange_n(piWord, &iOld, iNew, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
 #endif
-    return 0;
 }
 
-int before_mutex_create(mutex_t *m)
+static inline int casUChar(unsigned char *pucWord, unsigned char ucOld, unsigned char ucNew)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmutex_create - BEFORE - [%d]", taskExec->id);
+#if defined(__x86_64__)
+    unsigned char ucSwapped = 0;
+
+    __asm__ __volatile__("cmpxchgb %3, %1\n\t"
+                         "sete %0"
+                         : "=q"(ucSwapped), "+m"(*pucWord), "+a"(ucOld)
+                         : "q"(ucNew)
+                         : "memory", "cc");
+
+    return ucSwapped;
+#else
+    return __atomic_compare_exchange_n(pucWord, &ucOld, ucNew, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
 #endif
-    return 0;
 }
 
-int after_mutex_create(mutex_t *m)
+static inline void mutexOwn(task_t *pstTask, mutex_t *pstMutex)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmutex_create - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    pstMutex->pstOwner = pstTask;
+    pstMutex->pstNextHeld = pstTask->pstHeldMutexes;
+    pstTask->pstHeldMutexes = pstMutex;
+
+    return;
 }
 
-int before_mutex_lock(mutex_t *m)
+static void condRequeue(task_t *pstTask, mutex_t *pstMutex, char cMorph)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmutex_lock - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    // A signaller usually still holds the mutex and takes it again right
+    // after the unlock; handing it over to the woken task would make both
+    // switch on every item, so a lone waiter just runs when the signaller
+    // blocks and finds the mutex free by then
+    if (!cMorph && (NULL == pstMutex->queue))
+    {
+        task_resume(pstTask);
+        return;
+    }
+
+    if (MUTEX_FREE == pstMutex->value)
+    {
+        pstMutex->value = MUTEX_HELD;
+        mutexOwn(pstTask, pstMutex);
+        task_resume(pstTask);
+        return;
+    }
+
+    // The same state a task blocking in mutex_lock() leaves behind
+    task_suspend(pstTask, &(pstMutex->queue));
+    pstMutex->value = MUTEX_CONTENDED;
+    piBoostChain(pstTask, pstMutex);
+
+    return;
 }
 
-int after_mutex_lock(mutex_t *m)
+static int rwlockWait(rwlock_t *rw, task_t **ppstQueue)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmutex_lock - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    task_suspend(taskExec, ppstQueue);
+    preemptEnable();
+    task_yield();
+
+    // The unlock that woke the task up already counted it in
+    return rw->active ? 0 : -1;
 }
 
-int before_mutex_unlock(mutex_t *m)
+static void rwlockGrant(rwlock_t *rw, char cWriterLeft)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmutex_unlock - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    task_t *pstWriter = rw->writeQueue;
+
+    if ((NULL != rw->writer) || (0 < rw->countReaders))
+    {
+        return;
+    }
+
+    // Preferring the readers, the ones that waited for a writer go before
+    // the next one, but once they are done it is the turn of the writer
+    if ((NULL != pstWriter) &&
+        ((PPOS_RWLOCK_PREFER_WRITER == rw->mode) || (NULL == rw->readQueue) || !cWriterLeft))
+    {
+        rw->writer = pstWriter;
+        rw->countBypass = 0;
+        task_resume(pstWriter);
+        return;
+    }
+
+    while (NULL != rw->readQueue)
+    {
+        (rw->countReaders)++;
+        (rw->readQueue->uiReadLocks)++;
+        task_resume(rw->readQueue);
+    }
+
+    return;
 }
 
-int after_mutex_unlock(mutex_t *m)
+static void semTimedOut(task_t *pstTask)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmutex_unlock - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    (((semaphore_t *)pstTask->pvTimedWait)->value)++;
+
+    return;
 }
 
-int before_mutex_destroy(mutex_t *m)
+static void mutexTimedOut(task_t *pstTask)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmutex_destroy - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    mutex_t *pstMutex = (mutex_t *)pstTask->pvTimedWait;
+    task_t *pstOwner = pstMutex->pstOwner;
+
+    pstTask->pstBlockedOn = NULL;
+
+    if ((NULL == pstMutex->queue) && (MUTEX_CONTENDED == pstMutex->value))
+    {
+        pstMutex->value = MUTEX_HELD;
+    }
+
+    if (NULL != pstOwner)
+    {
+        piSetPrio(pstOwner, piEffectivePrio(pstOwner));
+    }
+
+    return;
 }
 
-int after_mutex_destroy(mutex_t *m)
+static void barrierTimedOut(task_t *pstTask)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmutex_destroy - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    (((barrier_t *)pstTask->pvTimedWait)->countTasks)--;
+
+    return;
 }
 
-int before_barrier_create(barrier_t *b, int N)
+static unsigned int fairWeight(task_t *pstTask)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nbarrier_create - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    int iPrio = pstTask->iStaticPrio;
+
+    iPrio = (iPrio < UNIX_MIN_PRIO) ? UNIX_MIN_PRIO : iPrio;
+    iPrio = (iPrio > UNIX_MAX_PRIO) ? UNIX_MAX_PRIO : iPrio;
+
+    return auiFairWeights[iPrio - UNIX_MIN_PRIO];
 }
 
-int after_barrier_create(barrier_t *b, int N)
+static int fairSlice(ST_RunQueue *pstRunQueue, task_t *pstTask)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nbarrier_create - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    unsigned long long ullTotalWeight = pstRunQueue->ullReadyWeight + fairWeight(pstTask);
+    int iSlice = (int)((FAIR_LATENCY_TICKS * (unsigned long long)fairWeight(pstTask)) / ullTotalWeight);
+
+    return (iSlice < FAIR_MIN_SLICE_TICKS) ? FAIR_MIN_SLICE_TICKS : iSlice;
 }
 
-int before_barrier_join(barrier_t *b)
+static void timerUnblock(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nbarrier_join - BEFORE - [%d]", taskExec->id);
+#ifdef PPOS_NATIVE_SWITCH
+    sigset_t stMask;
+
+    sigemptyset(&stMask);
+    sigaddset(&stMask, SIGALRM);
+    sigprocmask(SIG_UNBLOCK, &stMask, NULL);
 #endif
-    return 0;
+
+    return;
 }
 
-int after_barrier_join(barrier_t *b)
+static void preemptDisable(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nbarrier_join - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    // The library primitives called inside the section don't yield either
+    if ((0 == uiPreemptDepth) && (NULL != taskExec))
+    {
+        taskExec->iPreemptCheck = 1;
+    }
+
+    uiPreemptDepth++;
+
+    return;
 }
 
-int before_barrier_destroy(barrier_t *b)
+static void preemptEnable(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nbarrier_destroy - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    uiPreemptDepth--;
+
+    // Inside a library primitive this makes it yield as it returns
+    if ((0 == uiPreemptDepth) && cReschedPending && (taskExec != taskDisp))
+    {
+        taskExec->iPreemptCheck = 0;
+    }
+
+    return;
+}
+
+static int preemptCheckProbe(int iCheck)
+{
+    static task_t stProbeTask;
+    static semaphore_t stProbeSem;
+    task_t *pstSavedTask = taskExec;
+    unsigned char ucSavedPreemption = preemption;
+    volatile int iYielded = 0;
+
+    // A semaphore nobody waits on: sem_up() only counts and then checks the
+    // running task
+    stProbeSem.queue = NULL;
+    stProbeSem.value = 0;
+    stProbeSem.active = 1;
+    stProbeTask.iPreemptCheck = iCheck;
+    taskExec = &stProbeTask;
+
+    cYieldProbing = 1;
+
+    if (0 == setjmp(stYieldProbe))
+    {
+        sem_up(&stProbeSem);
+    }
+    else
+    {
+        iYielded = 1;
+    }
+
+    cYieldProbing = 0;
+
+    taskExec = pstSavedTask;
+    preemption = ucSavedPreemption;
+
+    return iYielded;
 }
 
-int after_barrier_destroy(barrier_t *b)
+static int preemptAllowed(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nbarrier_destroy - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    return ((0 == uiPreemptDepth) && PPOS_IS_PREEMPT_ACTIVE && (taskExec != taskDisp) && !switchInProgress());
 }
 
-int before_mqueue_create(mqueue_t *queue, int max, int size)
+static void preemptPoint(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_create - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    if (cReschedPending && preemptAllowed())
+    {
+        task_yield();
+    }
+
+    return;
 }
 
-int after_mqueue_create(mqueue_t *queue, int max, int size)
+static int preemptRequest(void *pvContext)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_create - AFTER - [%d]", taskExec->id);
+    // The switch already under way gives the processor away anyway
+    if (cTrampolineArmed)
+    {
+        return 1;
+    }
+
+    if (switchInProgress())
+    {
+        return 0;
+    }
+
+    cReschedPending = 1;
+
+    if (!preemptAllowed())
+    {
+        // Inside a library primitive the task yields as it returns, inside a
+        // section of this file at the preemptPoint() after it, or else on a
+        // later tick
+        if (0 == uiPreemptDepth)
+        {
+            taskExec->iPreemptCheck = 0;
+        }
+
+        return 0;
+    }
+
+#ifdef PPOS_RETURN_PREEMPT
+    if (0 != ulXsaveSize)
+    {
+        trampolineArm(pvContext);
+        return 1;
+    }
 #endif
-    return 0;
+
+    timerUnblock();
+    task_yield();
+
+    return 1;
 }
 
-int before_mqueue_send(mqueue_t *queue, void *msg)
+#ifdef PPOS_RETURN_PREEMPT
+static void trampolineInit(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_send - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    unsigned int uiEax = 0;
+    unsigned int uiEbx = 0;
+    unsigned int uiEcx = 0;
+    unsigned int uiEdx = 0;
+
+    // The kernel sets OSXSAVE once it manages the extended states
+    if (!__get_cpuid(1, &uiEax, &uiEbx, &uiEcx, &uiEdx) || !(uiEcx & bit_OSXSAVE))
+    {
+        return;
+    }
+
+    // EBX of leaf 0xD is the size for the components enabled in XCR0
+    __cpuid_count(0xD, 0, uiEax, uiEbx, uiEcx, uiEdx);
+    ulXsaveSize = uiEbx;
+
+    return;
 }
 
-int after_mqueue_send(mqueue_t *queue, void *msg)
+static void trampolineArm(void *pvContext)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_send - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    greg_t *pllRegs = ((ucontext_t *)pvContext)->uc_mcontext.gregs;
+
+    // Only one task is preempted at a time, metricsHandler() disarms it
+    llPreemptedRip = pllRegs[UCTX_GREG(UCTX_RIP)];
+    pllRegs[UCTX_GREG(UCTX_RIP)] = (greg_t)preemptTrampoline;
+    cTrampolineArmed = 1;
+
+    return;
 }
 
-int before_mqueue_recv(mqueue_t *queue, void *msg)
+static void __attribute__((used)) preemptYield(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_recv - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    task_yield();
+
+    return;
 }
 
-int after_mqueue_recv(mqueue_t *queue, void *msg)
-{
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_recv - AFTER - [%d]", taskExec->id);
+// The signal return lands here with the registers of the interrupted code,
+// which may be in the middle of any instruction sequence: the flags, the
+// caller-saved registers and the whole extended state (x87, SSE, AVX and
+// AVX-512) are saved on its stack, below the red zone, and restored after the
+// task runs again. The return address is taken from llPreemptedRip before
+// anything else, the next preemption may rewrite it.
+__asm__(".text\n"
+        ".type preemptTrampoline, @function\n"
+        "preemptTrampoline:\n"
+        "    leaq -" XSTR(RED_ZONE_SIZE) "(%rsp), %rsp\n"
+        "    pushq llPreemptedRip(%rip)\n"
+        "    pushfq\n"
+        "    cld\n"
+        "    pushq %rax\n"
+        "    pushq %rcx\n"
+        "    pushq %rdx\n"
+        "    pushq %rsi\n"
+        "    pushq %rdi\n"
+        "    pushq %r8\n"
+        "    pushq %r9\n"
+        "    pushq %r10\n"
+        "    pushq %r11\n"
+        "    pushq %rbx\n"
+        "    movq %rsp, %rbx\n"
+        "    subq ulXsaveSize(%rip), %rsp\n"
+        "    andq $-64, %rsp\n"
+        "    xorl %eax, %eax\n"
+        "    movq %rax, " XSTR(XSAVE_HEADER) "(%rsp)\n"
+        "    movq %rax, " XSTR(XSAVE_HEADER) "+8(%rsp)\n"
+        "    movq %rax, " XSTR(XSAVE_HEADER) "+16(%rsp)\n"
+        "    movq %rax, " XSTR(XSAVE_HEADER) "+24(%rsp)\n"
+        "    movq %rax, " XSTR(XSAVE_HEADER) "+32(%rsp)\n"
+        "    movq %rax, " XSTR(XSAVE_HEADER) "+40(%rsp)\n"
+        "    movq %rax, " XSTR(XSAVE_HEADER) "+48(%rsp)\n"
+        "    movq %rax, " XSTR(XSAVE_HEADER) "+56(%rsp)\n"
+        "    movl $-1, %eax\n"
+        "    movl $-1, %edx\n"
+        "    xsave64 (%rsp)\n"
+        "    call preemptYield\n"
+        "    movl $-1, %eax\n"
+        "    movl $-1, %edx\n"
+        "    xrstor64 (%rsp)\n"
+        "    movq %rbx, %rsp\n"
+        "    popq %rbx\n"
+        "    popq %r11\n"
+        "    popq %r10\n"
+        "    popq %r9\n"
+        "    popq %r8\n"
+        "    popq %rdi\n"
+        "    popq %rsi\n"
+        "    popq %rdx\n"
+        "    popq %rcx\n"
+        "    popq %rax\n"
+        "    popfq\n"
+        "    ret $" XSTR(RED_ZONE_SIZE) "\n"
+        ".size preemptTrampoline, .-preemptTrampoline\n");
 #endif
-    return 0;
-}
 
-int before_mqueue_destroy(mqueue_t *queue)
+static void tickHandler(int signum, siginfo_t *pstInfo, void *pvContext)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_destroy - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    unsigned long long ullNow = systime_ns();
+    unsigned int uiDueTick = 0;
+    int iExpired = 0;
+
+    if (0 == ullFirstTickNs)
+    {
+        ullFirstTickNs = ullNow;
+        uiFirstTick = systemTime + 1;
+    }
+
+    // Each signal delivers the ticks due by the monotonic clock, those of the
+    // signals that coalesced under load included, so the metrics and the
+    // quanta follow it
+    uiDueTick = uiFirstTick + (unsigned int)((ullNow - ullFirstTickNs) / CLOCK_NS_PER_MS);
+
+    // The shot of a sleep isn't a tick, the timer goes back to the next one
+    if ((0 != ullShotNs) && (ullNow >= ullShotNs))
+    {
+        ullShotNs = 0;
+        cShotDue = 1;
+
+        stTimer.it_value.tv_sec = 0;
+        stTimer.it_value.tv_usec = (ullFirstTickNs + ((unsigned long long)(uiDueTick + 1 - uiFirstTick) *
+                                                      CLOCK_NS_PER_MS) - ullNow + CLOCK_NS_PER_US - 1) /
+                                   CLOCK_NS_PER_US;
+        stTimer.it_interval.tv_sec = 0;
+        stTimer.it_interval.tv_usec = TIMER_PERIOD_uS;
+        setitimer(ITIMER_REAL, &stTimer, 0);
+    }
+
+    while ((int)(uiDueTick - systemTime) > 0)
+    {
+        systemTime++;
+
+        if (taskExec == taskDisp)
+        {
+            iTaskTicksQty--;
+
+            if (0 >= iTaskTicksQty)
+            {
+                iTaskTicksQty = DEFAULT_TASK_TICKS;
+            }
+        }
+        else if (taskTick(taskExec))
+        {
+            iExpired = 1;
+        }
+    }
+
+    // The sentinel is only touched where it sleeps, one out of sleepQueue
+    // is being drained and looks at cShotDue before going back
+    if (cShotDue && (NULL != stWheelSentinel.queue))
+    {
+        stWheelSentinel.awakeTime = systemTime;
+    }
+
+    edfCheckRelease();
+
+    // A task inside a critical section is preempted at the next safe point,
+    // or else asked again on the next tick
+    if ((taskExec != taskDisp) && (iExpired || cPreemptPending || cReschedPending))
+    {
+        preemptRequest(pvContext);
+    }
+
+    return;
 }
 
-int after_mqueue_destroy(mqueue_t *queue)
+static int switchInProgress(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_destroy - AFTER - [%d]", taskExec->id);
+    char cHere = 0;
+    char *pcStack = (char *)taskDisp->context.uc_stack.ss_sp;
+
+    if (cYielding)
+    {
+        return 1;
+    }
+
+#ifdef PPOS_DIRECT_SWITCH
+    // taskExec may already be the chosen task while the yielding one runs
+    if ((NULL != pstDirectNext) || cDirectCharged)
+    {
+        return 1;
+    }
 #endif
-    return 0;
+
+    return ((taskExec != taskDisp) && (&cHere >= pcStack) &&
+            (&cHere < (pcStack + taskDisp->context.uc_stack.ss_size)));
 }
 
-int before_mqueue_msgs(mqueue_t *queue)
+static void ticklessHandler(int signum, siginfo_t *pstInfo, void *pvContext)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_msgs - BEFORE - [%d]", taskExec->id);
-#endif
-    return 0;
+    int iExpired = ticklessCatchUp();
+
+    edfCheckRelease();
+
+    // The switch of a preempted task programs the timer
+    if (!((taskExec != taskDisp) && (iExpired || cPreemptPending || cReschedPending) &&
+          preemptRequest(pvContext)))
+    {
+        // Forces a new shot, the one that fired is gone
+        uiTimerExpiry = 0;
+        ticklessArm(taskExec);
+    }
+
+    return;
 }
 
-int after_mqueue_msgs(mqueue_t *queue)
+static void ticklessClockUpdate(void)
 {
-    // put your customization here
-#ifdef DEBUG
-    printf("\nmqueue_msgs - AFTER - [%d]", taskExec->id);
-#endif
-    return 0;
+    systemTime = (unsigned int)(systime_ns() / CLOCK_NS_PER_MS);
+
+    return;
 }
 
-void task_setprio(task_t *task, int prio)
+static int ticklessCatchUp(void)
 {
-    if ((UNIX_MIN_PRIO <= prio) && (UNIX_MAX_PRIO >= prio))
+    int iPreempt = 0;
+
+    ticklessClockUpdate();
+
+    // The dispatcher has no quantum to count down
+    if (taskExec == taskDisp)
     {
-        if (NULL != task)
-        {
-            task->iStaticPrio = prio;
-        }
-        else
+        uiLastTick = systemTime;
+        return 0;
+    }
+
+    while (uiLastTick < systemTime)
+    {
+        uiLastTick++;
+
+        if (taskTick(taskExec))
         {
-            taskExec->iStaticPrio = prio;
+            iPreempt = 1;
         }
     }
 
-    return;
+    return iPreempt;
 }
 
-int task_getprio(task_t *task)
+static void ticklessArm(task_t *pstNextTask)
 {
-    int iPrio = 0;
+    unsigned int uiDelay = TICKLESS_MAX_DEFER_MS;
+    unsigned int uiGroupDelay = groupNextEvent(pstNextTask);
 
-    if (NULL != task)
+    if (cPreemptPending || cReschedPending)
     {
-        iPrio = task->iStaticPrio;
+        uiDelay = 1;
     }
-    else
+    else if ((pstNextTask != taskDisp) && (0 != pstNextTask->uiPeriod))
+    {
+        uiDelay = pstNextTask->uiBudget - pstNextTask->uiBudgetUsed;
+    }
+    else if ((pstNextTask != taskDisp) && (NULL != pstPolicy->on_tick))
     {
-        iPrio = taskExec->iStaticPrio;
+        // A task still owing its preemption is checked again on the next tick
+        uiDelay = (iTaskTicksQty < 1) ? 1 : (unsigned int)iTaskTicksQty;
     }
 
-    return iPrio;
+    uiDelay = (uiDelay > TICKLESS_MAX_DEFER_MS) ? TICKLESS_MAX_DEFER_MS : uiDelay;
+
+    uiDelay = (uiGroupDelay < uiDelay) ? uiGroupDelay : uiDelay;
+    uiDelay = sleepNextEvent(uiDelay);
+    uiDelay = (0 == uiDelay) ? 1 : uiDelay;
+
+    // Most switches keep the event already programmed
+    if ((systemTime + uiDelay) == uiTimerExpiry)
+    {
+        return;
+    }
+
+    uiTimerExpiry = systemTime + uiDelay;
+
+    stTimer.it_value.tv_sec = uiDelay / 1000;
+    stTimer.it_value.tv_usec = (uiDelay % 1000) * 1000;
+    stTimer.it_interval.tv_sec = 0;
+    stTimer.it_interval.tv_usec = 0;
+
+    if (setitimer(ITIMER_REAL, &stTimer, 0) < 0)
+    {
+        perror("Setitimer error: ");
+        exit(1);
+    }
+
+    return;
 }
 
-task_t *scheduler()
+static unsigned int sleepNextEvent(unsigned int uiDelay)
 {
-    task_t *pstNextTask = readyQueue;
+    task_t *pstSleeper = sleepQueue;
 
-    if (NULL != readyQueue)
+    if (NULL == pstSleeper)
     {
-        pstNextTask = getHighestPrioTaks(readyQueue);
-        pstNextTask->iDinamPrio = pstNextTask->iStaticPrio;
+        return uiDelay;
+    }
 
-        task_t *pstListRunner = readyQueue;
-        task_t *pstFirstTask = readyQueue;
+    do
+    {
+        if (pstSleeper->awakeTime <= systemTime)
+        {
+            return 0;
+        }
 
-        // The tasks list is a circular list, so this is the way to run through it
-        do
+        if ((pstSleeper->awakeTime - systemTime) < uiDelay)
         {
-            if (pstListRunner != pstNextTask)
-            {
-                pstListRunner->iDinamPrio += UNIX_AGING_FACTOR;
-            }
+            uiDelay = pstSleeper->awakeTime - systemTime;
+        }
 
-            pstListRunner = pstListRunner->next;
-        } while (pstFirstTask != pstListRunner);
-    }
+        pstSleeper = pstSleeper->next;
+    } while (pstSleeper != sleepQueue);
 
-    return pstNextTask;
+    return uiDelay;
 }
 
-#if 0
-unsigned int systime()
+static void sleepShotArm(unsigned long long ullDeadline)
 {
-    return (unsigned int)systemTime;
-}
-#endif
+    sigset_t stSignals;
+    sigset_t stOldMask;
+    unsigned long long ullNextTickNs = 0;
+    unsigned long long ullNow = 0;
 
-// STATIC FUNCTIONS DEFINITIONS ================================================
+    // The tickless timer is already programmed for the tick of the wake up,
+    // and the first periodic tick is less than a period away
+    if (cTickless || (0 == ullFirstTickNs))
+    {
+        return;
+    }
+
+    sigemptyset(&stSignals);
+    sigaddset(&stSignals, SIGALRM);
+    sigprocmask(SIG_BLOCK, &stSignals, &stOldMask);
+
+    ullNextTickNs = ullFirstTickNs + ((unsigned long long)(systemTime + 1 - uiFirstTick) * CLOCK_NS_PER_MS);
+    ullNow = systime_ns();
+
+    if ((ullDeadline > ullNow) && (ullDeadline < ullNextTickNs) && ((0 == ullShotNs) || (ullDeadline < ullShotNs)))
+    {
+        ullShotNs = ullDeadline;
+
+        stTimer.it_value.tv_sec = 0;
+        stTimer.it_value.tv_usec = (ullDeadline - ullNow + CLOCK_NS_PER_US - 1) / CLOCK_NS_PER_US;
+        stTimer.it_interval.tv_sec = 0;
+        stTimer.it_interval.tv_usec = TIMER_PERIOD_uS;
+
+        if (setitimer(ITIMER_REAL, &stTimer, 0) < 0)
+        {
+            perror("Setitimer error: ");
+            exit(1);
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &stOldMask, 0);
+
+    return;
+}
 
-static task_t *getHighestPrioTaks(task_t *pstFirstTask)
+static void sleepShotExpire(void)
 {
-    task_t *pstHighestTask = pstFirstTask;
-    task_t *pstListRunner = pstFirstTask;
+    unsigned int uiTick = systemTime + 1;
+    unsigned long long ullNow = systime_ns();
+    unsigned long long ullNext = 0;
+    queue_t *pstSlot = &(astWheelSlots[uiTick & (WHEEL_L0_SLOTS - 1)]);
+    queue_t *pstLink = pstSlot->next;
+    task_t *pstTask = NULL;
 
-    do
+    cShotDue = 0;
+
+    // The sleeps that ended between two ticks were programmed a tick ahead at
+    // most, so they are in the first level slot of the next tick
+    while (pstLink != pstSlot)
     {
-        if (pstListRunner->iDinamPrio < pstHighestTask->iDinamPrio)
+        pstTask = (task_t *)((char *)pstLink - offsetof(task_t, stTimerLink));
+        pstLink = pstLink->next;
+
+        if ((uiTick != pstTask->awakeTime) || (0 == pstTask->ullAwakeNs))
+        {
+            continue;
+        }
+
+        if (pstTask->ullAwakeNs <= ullNow)
+        {
+            wheelRemove(pstTask);
+            task_resume(pstTask);
+        }
+        else if ((0 == ullNext) || (pstTask->ullAwakeNs < ullNext))
         {
-            pstHighestTask = pstListRunner;
+            ullNext = pstTask->ullAwakeNs;
         }
+    }
 
-        pstListRunner = pstListRunner->next;
-    } while (pstFirstTask != pstListRunner);
+    if (0 != ullNext)
+    {
+        sleepShotArm(ullNext);
+    }
 
-    return pstHighestTask;
+    return;
 }
 
-static void tickHandler(int signum)
+static void idleArm(void)
 {
-    static int iTaskTicksQty = DEFAULT_TASK_TICKS;
+    // The dispatcher only reaches scheduler() with a ready task, and wakes
+    // the sleeping ones up on every pass
+    wheelSentinelAt(systemTime);
 
-    iTaskTicksQty--;
-    systemTime++;
+    return;
+}
 
-    if (0 >= iTaskTicksQty)
+static void idleWait(void)
+{
+    sigset_t stSignals;
+    sigset_t stOldMask;
+    unsigned long long ullStart = 0;
+    unsigned int uiStartTick = systemTime;
+    unsigned int uiDelay = 0;
+    char cStretched = 0;
+
+    // The dispatcher ends once the last task has exited
+    if (0 >= countTasks)
     {
-        iTaskTicksQty = DEFAULT_TASK_TICKS;
+        return;
+    }
 
-        if (taskExec != taskDisp)
+    // The timer, the disk timer and the disk completion are the only events
+    // that make a task ready, they are held back until sigsuspend() so none
+    // is lost after the check
+    sigemptyset(&stSignals);
+    sigaddset(&stSignals, SIGALRM);
+    sigaddset(&stSignals, SIGIO);
+    sigaddset(&stSignals, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &stSignals, &stOldMask);
+
+    uiDelay = sleepNextEvent(IDLE_MAX_SLEEP_MS);
+
+    if ((NULL == readyQueue) && (0 != uiDelay))
+    {
+        if (cTickless)
         {
-            task_yield();
+            ticklessArm(taskDisp);
+        }
+        else if ((0 != ullFirstTickNs) && (1 < uiDelay))
+        {
+            // The ticks skipped are delivered by the catch up of the handler
+            stTimer.it_value.tv_sec = 0;
+            stTimer.it_value.tv_usec = uiDelay * TIMER_PERIOD_uS;
+            stTimer.it_interval.tv_sec = 0;
+            stTimer.it_interval.tv_usec = TIMER_PERIOD_uS;
+            setitimer(ITIMER_REAL, &stTimer, 0);
+            cStretched = 1;
+        }
+
+        ullStart = systime_ns();
+
+        sigdelset(&stOldMask, SIGALRM);
+        sigdelset(&stOldMask, SIGIO);
+        sigdelset(&stOldMask, SIGUSR1);
+        sigsuspend(&stOldMask);
+
+        ullIdleNs += systime_ns() - ullStart;
+
+        // A wake up before the stretched tick brings the period back
+        if (cStretched)
+        {
+            stTimer.it_value.tv_usec = TIMER_PERIOD_uS;
+            setitimer(ITIMER_REAL, &stTimer, 0);
         }
     }
 
+    sigprocmask(SIG_SETMASK, &stOldMask, 0);
+
+    if (cTickless)
+    {
+        ticklessClockUpdate();
+    }
+
+    uiIdleTicks += systemTime - uiStartTick;
+
+    // The next pass checks again, after waking the expired sleepers up
+    idleArm();
+
     return;
 }
 
 static void metricsHandler(task_t *pstPreviousTask, task_t *pstNextTask)
 {
-    (pstPreviousTask->uiProcessorTicks) += (systemTime - uiTaskStartingTick);
+    unsigned int uiUsedTicks = systemTime - uiTaskStartingTick;
+
+    // The dispatcher is only charged for the time it was not idle
+    if (pstPreviousTask == taskDisp)
+    {
+        uiUsedTicks = (uiIdleTicks < uiUsedTicks) ? (uiUsedTicks - uiIdleTicks) : 0;
+        uiIdleTicks = 0;
+    }
+
+    (pstPreviousTask->uiProcessorTicks) += uiUsedTicks;
+
+    // Heavier tasks have a slower virtual clock
+    (pstPreviousTask->ullVRuntime) += ((unsigned long long)uiUsedTicks * 1000 * FAIR_NICE_0_WEIGHT) /
+                                      fairWeight(pstPreviousTask);
+
+    if (pstPreviousTask != taskDisp)
+    {
+        quantumAdapt(pstPreviousTask, uiUsedTicks);
+        groupCharge(pstPreviousTask, uiUsedTicks);
+    }
+
+    cQuantumExpired = 0;
+    cPreemptPending = 0;
+
+    // The preemption the previous task owed, if any, is this switch
+    cReschedPending = 0;
+    cTrampolineArmed = 0;
+    pstPreviousTask->iPreemptCheck = 1;
 
     (pstNextTask->uiActivations)++;
 
@@ -63,6 +63,18 @@ void before_task_create (task_t *task );
 void after_task_create (task_t *task );  // Após o retorno dessa funcao, a nova tarefa é incluída na
                                          // fila de tarefas prontas.
 
+// inicializa atributos de criacao com os valores padrao: pilha de STACKSIZE
+// bytes, prioridade 0 e tarefa que pode ser esperada com task_join
+void task_attr_init (task_attr_t *attr) ;
+
+// cria uma tarefa com os atributos indicados (NULL usa os padrao). Uma tarefa
+// "detached" pode ser criada com task NULL: o descritor eh alocado pelo
+// sistema e liberado quando ela termina. Retorna um ID> 0 ou erro.
+int task_create_ex (task_t *task,			// descritor da nova tarefa ou NULL
+                    const task_attr_t *attr,		// atributos de criacao
+                    void (*start_func)(void *),	// funcao corpo da tarefa
+                    void *arg) ;			// argumentos para a tarefa
+
 // Termina a tarefa corrente, indicando um valor de status encerramento
 void task_exit (int exitCode) ;
 void before_task_exit ();
@@ -106,6 +118,39 @@ int task_getprio (task_t *task) ;
 // retorna a proxima tarefa a ser executada conforme a politica de escalonamento
 task_t *scheduler() ;
 
+// registra uma politica de escalonamento; as politicas "aging", "aging-bitmap",
+// "fair", "fifo" e "rr" sao registradas por ppos_init(). Retorna 0 ou erro.
+int sched_register (sched_policy_t *policy) ;
+
+// seleciona a politica de escalonamento pelo nome, levando as tarefas prontas
+// para ela. ppos_init() usa a variavel de ambiente PPOS_SCHED_POLICY, se
+// definida. Retorna 0 ou erro.
+int sched_setpolicy (const char *name) ;
+
+// retorna o nome da politica de escalonamento em uso
+const char *sched_getpolicy () ;
+
+// coloca uma tarefa (ou a tarefa atual) na classe de tempo real (EDF), com
+// periodo e orcamento de processador em milissegundos; period 0 a devolve
+// para a classe normal. Retorna 0 ou erro, caso a utilizacao passe de 100%.
+int task_set_deadline (task_t *task, unsigned int period, unsigned int budget) ;
+
+// encerra o job atual da tarefa de tempo real, dormindo ate o proximo periodo
+void task_wait_period () ;
+
+// inicializa um grupo de tarefas com o peso indicado (0 usa o peso padrao,
+// 1024). Retorna 0 ou erro.
+int task_group_create (task_group_t *group, unsigned int shares) ;
+
+// coloca uma tarefa (ou a tarefa atual) em um grupo; group NULL a devolve ao
+// grupo raiz. Tarefas novas entram no grupo da tarefa que as cria. Retorna 0
+// ou erro.
+int task_group_attach (task_group_t *group, task_t *task) ;
+
+// limita o grupo a quota ms de processador a cada period ms; quota 0 remove
+// o limite. Retorna 0 ou erro.
+int task_group_set_quota (task_group_t *group, unsigned int quota, unsigned int period) ;
+
 // operações de gestão do tempo ================================================
 
 // suspende a tarefa corrente por t milissegundos
@@ -117,6 +162,21 @@ void after_task_sleep () ;
 // retorna o valor atual do relógio do sistema (em milisegundos)
 unsigned int systime () ;
 
+// retorna o relogio monotonico (CLOCK_MONOTONIC) em nanossegundos desde
+// ppos_init(), em 64 bits
+unsigned long long systime_ns () ;
+
+// retorna o tempo, em nanossegundos, em que o processo ficou bloqueado por nao
+// haver tarefa pronta; ele nao eh contado como tempo do dispatcher
+unsigned long long systime_idle_ns () ;
+
+// suspende a tarefa corrente por us microssegundos
+void task_sleep_us (unsigned long long us) ;
+
+// suspende a tarefa corrente ate o instante ns de systime_ns(); retorna logo
+// se ele ja passou
+void task_sleep_until (unsigned long long ns) ;
+
 // operações de sincronização ==================================================
 
 // a tarefa corrente aguarda o encerramento de outra task
@@ -124,6 +184,14 @@ int task_join (task_t *task) ;
 int before_task_join (task_t *task) ;
 int after_task_join (task_t *task) ;
 
+// as operacoes *_timed desistem da espera no instante deadline de systime_ns(),
+// retornando PPOS_ETIMEDOUT; se o prazo ja passou, so esperam o que estiver
+// livre. O prazo eh verificado nos ticks do relogio do sistema.
+
+// aguarda o encerramento de outra task ate o prazo; retorna o codigo de
+// encerramento dela, PPOS_ETIMEDOUT ou erro
+int task_join_timed (task_t *task, unsigned long long deadline) ;
+
 // operações de IPC ============================================================
 
 // semáforos
@@ -138,6 +206,9 @@ int sem_down (semaphore_t *s) ;
 int before_sem_down (semaphore_t *s) ;
 int after_sem_down (semaphore_t *s) ;
 
+// requisita o semáforo ate o prazo; retorna 0, PPOS_ETIMEDOUT ou erro
+int sem_down_timed (semaphore_t *s, unsigned long long deadline) ;
+
 // libera o semáforo
 int sem_up (semaphore_t *s) ;
 int before_sem_up (semaphore_t *s) ;
@@ -160,6 +231,9 @@ int mutex_lock (mutex_t *m) ;
 int before_mutex_lock (mutex_t *m) ;
 int after_mutex_lock (mutex_t *m) ;
 
+// Solicita um mutex ate o prazo; retorna 0, PPOS_ETIMEDOUT ou erro
+int mutex_lock_timed (mutex_t *m, unsigned long long deadline) ;
+
 // Libera um mutex
 int mutex_unlock (mutex_t *m) ;
 int before_mutex_unlock (mutex_t *m) ;
@@ -170,6 +244,47 @@ int mutex_destroy (mutex_t *m) ;
 int before_mutex_destroy (mutex_t *m) ;
 int after_mutex_destroy (mutex_t *m) ;
 
+// variaveis de condicao
+
+// Inicializa uma variavel de condicao
+int cond_create (cond_t *cond) ;
+
+// Libera o mutex e espera a condicao; retorna com o mutex de volta, 0 ou -1
+// se a condicao foi destruida. As tarefas que esperam juntas usam o mesmo
+// mutex.
+int cond_wait (cond_t *cond, mutex_t *m) ;
+
+// Acorda uma das tarefas esperando a condicao / todas elas. No broadcast, ou
+// quando ja ha tarefas esperando o mutex, elas passam direto para a fila do
+// mutex, sem acordar so para bloquear de novo nele.
+int cond_signal (cond_t *cond) ;
+int cond_broadcast (cond_t *cond) ;
+
+// Destrói uma variavel de condicao, acordando as tarefas que a esperam
+int cond_destroy (cond_t *cond) ;
+
+// rwlocks
+
+// Inicializa um rwlock livre. mode PPOS_RWLOCK_PREFER_WRITER faz os leitores
+// novos esperarem se houver escritor esperando; PPOS_RWLOCK_PREFER_READER os
+// deixa entrar junto dos que ja leem, mas so ate PPOS_RWLOCK_READER_BYPASS
+// deles, e libera os leitores esperando antes do proximo escritor. Nos dois
+// modos um escritor nunca espera indefinidamente.
+int rwlock_create (rwlock_t *rw, int mode) ;
+
+// Solicita o rwlock para leitura, compartilhado com outros leitores
+int rwlock_rdlock (rwlock_t *rw) ;
+
+// Solicita o rwlock para escrita, exclusivo
+int rwlock_wrlock (rwlock_t *rw) ;
+
+// Libera o rwlock, obtido para leitura ou para escrita. Retorna -1 se a
+// tarefa nao tem o rwlock
+int rwlock_unlock (rwlock_t *rw) ;
+
+// Destrói um rwlock, liberando as tarefas bloqueadas
+int rwlock_destroy (rwlock_t *rw) ;
+
 // barreiras
 
 // Inicializa uma barreira
@@ -182,6 +297,10 @@ int barrier_join (barrier_t *b) ;
 int before_barrier_join (barrier_t *b) ;
 int after_barrier_join (barrier_t *b) ;
 
+// Chega a uma barreira, esperando as demais tarefas ate o prazo; retorna 0,
+// PPOS_ETIMEDOUT ou erro
+int barrier_join_timed (barrier_t *b, unsigned long long deadline) ;
+
 // Destrói uma barreira
 int barrier_destroy (barrier_t *b) ;
 int before_barrier_destroy (barrier_t *b) ;
@@ -199,11 +318,19 @@ int mqueue_send (mqueue_t *queue, void *msg) ;
 int before_mqueue_send (mqueue_t *queue, void *msg) ;
 int after_mqueue_send (mqueue_t *queue, void *msg) ;
 
+// envia uma mensagem, esperando uma vaga na fila ate o prazo; retorna 0,
+// PPOS_ETIMEDOUT ou erro
+int mqueue_send_timed (mqueue_t *queue, void *msg, unsigned long long deadline) ;
+
 // recebe uma mensagem da fila
 int mqueue_recv (mqueue_t *queue, void *msg) ;
 int before_mqueue_recv (mqueue_t *queue, void *msg) ;
 int after_mqueue_recv (mqueue_t *queue, void *msg) ;
 
+// recebe uma mensagem, esperando ate o prazo; retorna 0, PPOS_ETIMEDOUT ou
+// erro
+int mqueue_recv_timed (mqueue_t *queue, void *msg, unsigned long long deadline) ;
+
 // destroi a fila, liberando as tarefas bloqueadas
 int mqueue_destroy (mqueue_t *queue) ;
 int before_mqueue_destroy (mqueue_t *queue) ;
@@ -214,6 +341,61 @@ int mqueue_msgs (mqueue_t *queue) ;
 int before_mqueue_msgs (mqueue_t *queue) ;
 int after_mqueue_msgs (mqueue_t *queue) ;
 
+// envio e recebimento sem copia: mqueue_reserve espera uma vaga e retorna o
+// endereco dela, onde a mensagem eh escrita direto, e mqueue_commit a
+// entrega; mqueue_peek espera uma mensagem e retorna o endereco dela na
+// fila, e mqueue_release libera a vaga. Cada lado atende uma tarefa por vez:
+// os outros envios (recebimentos) esperam o commit (release). Retornam NULL
+// ou -1 em erro
+void *mqueue_reserve (mqueue_t *queue) ;
+int mqueue_commit (mqueue_t *queue) ;
+void *mqueue_peek (mqueue_t *queue) ;
+int mqueue_release (mqueue_t *queue) ;
+
+// envio e recebimento com copia pelo anel. A primeira operacao usada numa
+// fila fixa a disposicao das mensagens: linear para as da biblioteca, as
+// *_timed e ltask_mqueue_*, anel para estas, reserve/commit e peek/release.
+// Na fila da outra disposicao elas retornam -1 (ou NULL); mqueue_msgs serve
+// para as duas
+int mqueue_send_ring (mqueue_t *queue, void *msg) ;
+int mqueue_recv_ring (mqueue_t *queue, void *msg) ;
+
+// caminho rapido dos semaforos e mutexes: sem disputa, requisitar ou liberar
+// eh uma unica troca atomica (compare-and-swap) no valor, sem tocar na fila;
+// sob disputa elas chamam as operacoes acima. Quem quer o caminho rapido as
+// chama no lugar de sem_down, sem_up, mutex_lock e mutex_unlock; as duas
+// formas podem ser usadas no mesmo semaforo ou mutex.
+int sem_down_fast (semaphore_t *s) ;
+int sem_up_fast (semaphore_t *s) ;
+int mutex_lock_fast (mutex_t *m) ;
+int mutex_unlock_fast (mutex_t *m) ;
+
+// tarefas leves ===============================================================
+
+// As tarefas leves executam uma apos a outra sobre a pilha de uma unica tarefa
+// do sistema, escalonada pelo despachante como as demais. A funcao de uma
+// tarefa leve executa ate retornar e nao deve chamar operacoes que bloqueiam
+// (task_sleep, sem_down, mqueue_recv...). Antes de retornar ela pode indicar,
+// com as chamadas abaixo, a funcao que continua seu trabalho; se nao indicar
+// nenhuma, a tarefa leve termina e seu descritor pode ser reutilizado.
+
+// cria uma tarefa leve que executa func (task, arg). Retorna 0 ou erro.
+int ltask_create (ltask_t *task, void (*func)(ltask_t *, void *), void *arg) ;
+
+// a tarefa leve corrente volta ao fim da fila e continua em func. Retorna 0
+// ou erro.
+int ltask_yield (ltask_t *task, void (*func)(ltask_t *, void *)) ;
+
+// a tarefa leve corrente espera o semaforo e continua em func, com
+// task->result 0, ou -1 se o semaforo for destruido. Retorna 0 ou erro.
+int ltask_sem_down (ltask_t *task, semaphore_t *s, void (*func)(ltask_t *, void *)) ;
+
+// a tarefa leve corrente envia/recebe uma mensagem e continua em func, com
+// task->result 0, ou -1 se a fila for destruida. O buffer msg deve existir
+// ate la. Retornam 0 ou erro.
+int ltask_mqueue_send (ltask_t *task, mqueue_t *queue, void *msg, void (*func)(ltask_t *, void *)) ;
+int ltask_mqueue_recv (ltask_t *task, mqueue_t *queue, void *msg, void (*func)(ltask_t *, void *)) ;
+
 // funcao para debug. imprime os campos da estrutura task_t
 void print_tcb( task_t* task );
 
@@ -285,8 +467,17 @@ void print_tcb( task_t* task );
 #define PPOS_TASK_STATE_SUSPENDED  'S'
 #define PPOS_TASK_STATE_TERMINATED 'T'
 
+#define PPOS_TASK_IO_BOUND         'i'
+#define PPOS_TASK_CPU_BOUND        'c'
+
 #define STACKSIZE              32768
 
+#define PPOS_ETIMEDOUT         (-2)   // prazo de uma operacao *_timed expirou
+
+#define PPOS_RWLOCK_PREFER_WRITER  0
+#define PPOS_RWLOCK_PREFER_READER  1
+#define PPOS_RWLOCK_READER_BYPASS  16  // leitores que passam a frente de um escritor
+
 #define PRINT_READY_QUEUE      queue_print ("Ready Queue", (queue_t*)readyQueue, (void*)&print_tcb );
 #define PPOS_PREEMPT_ENABLE    preemption = 1;
 #define PPOS_PREEMPT_DISABLE   preemption = 0;
@@ -11,8 +11,13 @@
 #include <ucontext.h>		// biblioteca POSIX de trocas de contexto
 #include "queue.h"		// biblioteca de filas genéricas
 
+struct mutex_t ;
+struct task_group_t ;
+
 // Estrutura que define um Task Control Block (TCB)
-typedef struct task_t
+// Alinhada a 64 bytes para que os campos do escalonador, logo apos awakeTime,
+// ocupem uma unica linha de cache
+typedef struct __attribute__((aligned(64))) task_t
 {
     struct task_t *prev, *next ;  // ponteiros para usar em filas
     int id ;                      // identificador da tarefa
@@ -25,16 +30,129 @@ typedef struct task_t
     unsigned int awakeTime; // used to store the time when it should be waked up
 
     // ... (outros campos deve ser adicionados APOS esse comentario)
-    // Priorities for aging
+    // Hot fields, read by every scheduling decision: they fill the cache line
+    // that starts here. iPreemptCheck must stay at offset 0x408, the library
+    // IPC primitives read it there; before_ppos_init() checks that they do
+
+    // Priorities for aging, iStaticPrio is raised by priority inheritance
     int iStaticPrio;
     int iDinamPrio;
 
-    // Task metrics
+    // Deferred preemption: 0 while the task owes a preemption, which makes
+    // the library IPC primitives yield as they return, 1 otherwise
+    int iPreemptCheck;
+
+    // Position in the scheduler ready heap, 0 when out of it
+    int iHeapIdx;
+
+    // Adaptive quantum: ticks given at each activation
+    int iQuantumTicks;
+
+    // Real-time class: period in ms (0 for normal tasks) and absolute deadline
+    // of the current job
+    unsigned int uiPeriod;
+    unsigned int uiDeadline;
+
+    // Whether the task is counted among the ready tasks of its group and
+    // whether it behaves as I/O or CPU bound (PPOS_TASK_*_BOUND)
+    unsigned char ucGroupReady;
+    unsigned char ucBehavior;
+
+    // Processor time weighted by the priority, in microseconds
+    unsigned long long ullVRuntime;
+
+    // Links of the bitmap run queues, next is NULL when out of them
+    queue_t stRunLink;
+
+    // Task group the task belongs to
+    struct task_group_t *pstGroup;
+
+    // Cold fields, used by accounting, task_exit and the mutexes
+
+    // Task metrics: system time at creation, then execution time
     unsigned int uiExecTicks;
     unsigned int uiProcessorTicks;
     unsigned int uiActivations;
+    unsigned int uiDeadlineMisses;
+
+    // Adaptive quantum: average run burst
+    unsigned int uiAvgBurstTicks;
+
+    // Real-time class: budget in ms and the part of it the current job used
+    unsigned int uiBudget;
+    unsigned int uiBudgetUsed;
+
+    // Priority inheritance: priority set by task_setprio(), mutexes held by
+    // the task and the one it is blocked on
+    int iBasePrio;
+    struct mutex_t *pstHeldMutexes;
+    struct mutex_t *pstBlockedOn;
+
+    // Creation attributes: detached tasks are not joined, and the ones whose
+    // task_t was allocated by task_create_ex() have it freed after they exit
+    unsigned char ucDetached;
+    unsigned char ucSystemTcb;
+
+    // Links of the timing wheel slot the task sleeps in, next is NULL when
+    // out of the wheel
+    queue_t stTimerLink;
+
+    // Monotonic clock, in nanoseconds, of a sleep that ends before the tick
+    // it waits for, 0 for the other waits
+    unsigned long long ullAwakeNs;
+
+    // Timed waits: primitive the task waits on until awakeTime, what fixes
+    // its counters when the deadline takes the task out of its queue, and
+    // whether that happened to the last wait
+    void *pvTimedWait;
+    void (*pfnTimedOut)(struct task_t *task);
+    unsigned char ucTimedOut;
+
+    // Read locks the task holds, over every rwlock
+    unsigned int uiReadLocks;
 } task_t;
 
+// atributos de criacao de uma tarefa, ver task_attr_init()
+typedef struct
+{
+    size_t stacksize;             // tamanho da pilha em bytes, 0 usa STACKSIZE
+    int prio;                     // prioridade estatica inicial
+    unsigned char detached;       // a tarefa nao sera esperada com task_join
+} task_attr_t ;
+
+// estrutura que define uma politica de escalonamento. Somente pick_next eh
+// obrigatoria, as demais podem ser NULL
+typedef struct
+{
+    const char *name;                 // nome usado para selecionar a politica
+    void (*enqueue)(task_t *task);    // a tarefa entrou na fila de prontas
+    void (*dequeue)(task_t *task);    // a tarefa saiu da fila de prontas sem ser escolhida
+    task_t *(*pick_next)(void);       // retira e retorna a proxima tarefa, NULL se nao houver
+    int (*on_tick)(task_t *task);     // tick da tarefa em execucao, != 0 a preempta
+    void (*on_wake)(task_t *task);    // a tarefa suspensa vai voltar para a fila de prontas
+} sched_policy_t ;
+
+// estrutura que define um grupo de tarefas. Os grupos dividem o processador
+// na proporcao de seus pesos e, dentro de cada grupo, a politica divide o
+// tempo do grupo entre suas tarefas
+typedef struct task_group_t
+{
+    unsigned int shares;          // peso do grupo
+    unsigned int quota;           // ms de processador por periodo, 0 sem limite
+    unsigned int period;          // periodo da cota, em ms
+    unsigned int usage;           // ms de processador usados pelas tarefas do grupo
+
+    // Scheduler state: quota used in the current period and when it started,
+    // ready tasks, processor time weighted by the shares in microseconds, the
+    // run queue of the built-in policies and the next group of the list
+    unsigned int uiQuotaUsed;
+    unsigned int uiPeriodStart;
+    unsigned int uiReadyTasks;
+    unsigned long long ullVRuntime;
+    void *pvRunQueue;
+    struct task_group_t *pstNext;
+} task_group_t ;
+
 // estrutura que define um semáforo
 typedef struct {
     struct task_t *queue;
@@ -44,13 +162,35 @@ typedef struct {
 } semaphore_t ;
 
 // estrutura que define um mutex
-typedef struct {
+typedef struct mutex_t {
     struct task_t *queue;
     unsigned char value;
 
     unsigned char active;
+
+    // Priority inheritance: task holding the mutex and the next mutex it holds
+    struct task_t *pstOwner;
+    struct mutex_t *pstNextHeld;
 } mutex_t ;
 
+// estrutura que define uma variavel de condicao
+typedef struct {
+    struct task_t *queue;
+    struct mutex_t *mutex;  // mutex que as tarefas esperando liberaram
+    unsigned char active;
+} cond_t ;
+
+// estrutura que define um rwlock: varios leitores ou um so escritor
+typedef struct {
+    struct task_t *readQueue;   // leitores esperando
+    struct task_t *writeQueue;  // escritores esperando
+    struct task_t *writer;      // escritor com o lock, se houver
+    int countReaders;           // leitores com o lock
+    int countBypass;            // leitores que passaram a frente de um escritor
+    unsigned char mode;         // PPOS_RWLOCK_PREFER_WRITER ou _READER
+    unsigned char active;
+} rwlock_t ;
+
 // estrutura que define uma barreira
 typedef struct {
     struct task_t *queue;
@@ -72,7 +212,42 @@ typedef struct {
     semaphore_t sVaga;
     
     unsigned char active;
+
+    // Disposicao das mensagens em content, fixada pela primeira operacao:
+    // nenhuma ainda, linear (operacoes da biblioteca, *_timed e ltask_mqueue_*)
+    // ou anel (operacoes sem copia)
+    unsigned char layout;
+
+    // As mensagens ficam num anel: a mais antiga e a proxima vaga, mensagens
+    // e vagas do anel. Um envio e um recebimento por vez, quem reservou a vaga
+    // ou olha a mensagem
+    int head;
+    int tail;
+    semaphore_t sRingItem;
+    semaphore_t sRingVaga;
+    semaphore_t sSend;
+    semaphore_t sRecv;
+    struct task_t *sender;
+    struct task_t *receiver;
 } mqueue_t ;
 
+// estrutura que define uma tarefa leve: uma funcao executada ate retornar,
+// sobre uma pilha compartilhada, que pode indicar a funcao que continua seu
+// trabalho depois de uma espera
+typedef struct ltask_t
+{
+    struct ltask_t *next;                    // ponteiro para usar em filas
+    void (*func)(struct ltask_t *, void *);  // proxima funcao a executar
+    void *arg;                               // argumento das funcoes
+    int result;                              // resultado da ultima espera: 0 ou -1
+
+    // Wait in progress: semaphore waited on, message queue operation with its
+    // message buffer and the continuation to call when it completes
+    semaphore_t *pstWaitSem;
+    mqueue_t *pstMqueue;
+    void *pvMsg;
+    void (*pfnDone)(struct ltask_t *, void *);
+} ltask_t ;
+
 #endif
 
@@ -45,6 +45,18 @@ static int diskScheduler();
  */
 static void memActionFinished();
 
+/**
+ * @brief Hands a request over to the disk once the previous one is done,
+ * unless the deadline comes first
+ *
+ * @param block       Block number where the action will be done
+ * @param buffer      Buffer where the data will be stored/read
+ * @param cTaskAction DISK_CMD_READ or DISK_CMD_WRITE
+ * @param deadline    Deadline, in nanoseconds of systime_ns()
+ * @return int        0 on success, PPOS_ETIMEDOUT or -1 on error
+ */
+static int diskRequestTimed(int block, void *buffer, char cTaskAction, unsigned long long deadline);
+
 //////////////// EXTERNABLE FUNCTIONS DESCRIPTIONS ///////////////
 
 // operações oferecidas pelo disco
@@ -116,7 +128,7 @@ extern int disk_block_read(int block, void *buffer)
 {
    addNodeInFront(gpstRequestList, taskExec, block, buffer, DISK_CMD_READ, systemTime);
 
-   mutex_lock(&disk.mRequest);
+   mutex_lock_fast(&disk.mRequest);
 
    // if (disk.packageSync > 0)
    // {
@@ -138,7 +150,7 @@ extern int disk_block_read(int block, void *buffer)
    // }
    // disk.packageSync--;
 
-   mutex_unlock(&disk.mRequest);
+   mutex_unlock_fast(&disk.mRequest);
 
    return 0;
 }
@@ -147,7 +159,7 @@ extern int disk_block_write(int block, void *buffer)
 {
    addNodeInFront(gpstRequestList, taskExec, block, buffer, DISK_CMD_WRITE, systemTime);
 
-   mutex_lock(&disk.mRequest);
+   mutex_lock_fast(&disk.mRequest);
 
    // if (disk.packageSync > 0)
    // {
@@ -169,11 +181,21 @@ extern int disk_block_write(int block, void *buffer)
    // }
    // disk.packageSync = 0;
 
-   mutex_unlock(&disk.mRequest);
+   mutex_unlock_fast(&disk.mRequest);
 
    return 0;
 }
 
+extern int disk_block_read_timed(int block, void *buffer, unsigned long long deadline)
+{
+   return diskRequestTimed(block, buffer, DISK_CMD_READ, deadline);
+}
+
+extern int disk_block_write_timed(int block, void *buffer, unsigned long long deadline)
+{
+   return diskRequestTimed(block, buffer, DISK_CMD_WRITE, deadline);
+}
+
 extern void memActionFinished()
 {
    disk.packageSync++;
@@ -198,6 +220,27 @@ static void diskTaskBody()
 
 ///////////////// STATIC FUNCTIONS DESCRIPTIONS /////////////////
 
+static int diskRequestTimed(int block, void *buffer, char cTaskAction, unsigned long long deadline)
+{
+   int iResult = mutex_lock_timed(&disk.mRequest, deadline);
+
+   if (0 != iResult)
+   {
+      return iResult;
+   }
+
+   // The request only enters the list once it is the next one, a request
+   // that timed out leaves nothing behind for the disk task
+   addNodeInFront(gpstRequestList, taskExec, block, buffer, cTaskAction, systemTime);
+
+   sem_up(&disk.newReqsSem);
+   sem_down(&disk.treatedReqSem);
+
+   mutex_unlock_fast(&disk.mRequest);
+
+   return 0;
+}
+
 ST_RequestNode *fcfsSched()
 {
    return gpstRequestList->firstNode;
@@ -409,7 +452,7 @@ extern void addNodeInFront(ST_RequestList *pstList,
       return;
    }
 
-   mutex_lock(&disk.queueMutex);
+   mutex_lock_fast(&disk.queueMutex);
    if (NULL == pstList->firstNode)
    {
       ST_RequestNode *pstNewNode = createNode(NULL, NULL, pstTask, block, buffer, cTaskAction, uiStartingTick);
@@ -423,7 +466,7 @@ extern void addNodeInFront(ST_RequestList *pstList,
       pstList->lastNode = pstNewNode;
    }
    (pstList->iSize)++;
-   mutex_unlock(&disk.queueMutex);
+   mutex_unlock_fast(&disk.queueMutex);
    return;
 }
 
@@ -109,6 +109,29 @@ extern int disk_block_read (int block, void *buffer);
 // escrita de um bloco, do buffer para o disco
 extern int disk_block_write (int block, void *buffer);
 
+/**
+ * @brief Reads a block like disk_block_read(), giving up when the disk hasn't
+ * taken the request by a deadline. Once taken, the transfer is waited for,
+ * the disk writes into the buffer.
+ *
+ * @param block    Block number to be read
+ * @param buffer   Buffer where the data will be stored
+ * @param deadline Deadline, in nanoseconds of systime_ns()
+ * @return int     0 on success, PPOS_ETIMEDOUT or -1 on error
+ */
+extern int disk_block_read_timed (int block, void *buffer, unsigned long long deadline);
+
+/**
+ * @brief Writes a block like disk_block_write(), giving up when the disk
+ * hasn't taken the request by a deadline
+ *
+ * @param block    Block number to be written
+ * @param buffer   Buffer where the data is read from
+ * @param deadline Deadline, in nanoseconds of systime_ns()
+ * @return int     0 on success, PPOS_ETIMEDOUT or -1 on error
+ */
+extern int disk_block_write_timed (int block, void *buffer, unsigned long long deadline);
+
 /**
  * @brief Create a List object and returns it
  * 